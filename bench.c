@@ -0,0 +1,295 @@
+/*
+ * Very simple but very effective user-space memory tester.
+ * Originally by Simon Kirby <sim@stormix.com> <sim@neato.org>
+ * Version 2 by Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Version 3 not publicly released.
+ * Version 4 rewrite:
+ * Copyright (C) 2004-2020 Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains a microbenchmark of memtester's own code, built with
+ * `make bench`.  It runs compare_regions() and every test in tests[] on
+ * regions which fit in the L1, L2 and last-level caches and on one which
+ * does not, and prints the time per word touched and the bandwidth, next to
+ * those of memset(3) and memcpy(3) on the same region.  Each figure is the
+ * best of several timed repetitions after an untimed warmup, and each
+ * repetition runs long enough to be timed reliably.  Pattern tests run only
+ * a few of their passes, since every pass does the same work.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "types.h"
+#include "sizes.h"
+#include "memtester.h"
+#include "tests.h"
+#include "output.h"
+#include "threads.h"
+#include "kernels.h"
+#include "rng.h"
+
+#define BENCH_PASSES 4          /* passes of each pattern test timed */
+#define BENCH_MIN_SECONDS 0.02  /* shortest repetition timed */
+#define LEVEL_MAX 4
+
+/* Globals the tests expect from memtester.c. */
+int use_phys = 0;
+off_t physaddrbase = 0;
+struct phys_range phys_ranges[PHYS_RANGES_MAX];
+unsigned int n_phys_ranges = 0;
+int verify_expected = 0;
+
+struct level {
+    const char *name;
+    size_t bytes;               /* of the region tested, both halves */
+};
+
+/* What one benchmark does to the region of the current worker. */
+typedef void (*bench_fn)(struct worker *w, const void *arg);
+
+static struct worker w;
+static int reps = 5;
+
+static int usage(char *me) {
+    fprintf(stderr, "\nUsage: %s [-k kernels] [-n] [-e] [-r repetitions] "
+            "[-m dram-size[K|M|G]]\n", me);
+    return 1;
+}
+
+/* Size of the data or unified cache at the given level, from sysfs. */
+static size_t cache_size(int level) {
+    char path[128], type[32];
+    unsigned long size;
+    int i, l;
+    char unit;
+    FILE *f;
+
+    for (i = 0; i < 16; i++) {
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu0/cache/index%d/level", i);
+        if (!(f = fopen(path, "r"))) {
+            break;
+        }
+        l = 0;
+        if (fscanf(f, "%d", &l) != 1) {
+            l = 0;
+        }
+        fclose(f);
+        if (l != level) {
+            continue;
+        }
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu0/cache/index%d/type", i);
+        if (!(f = fopen(path, "r"))) {
+            continue;
+        }
+        type[0] = '\0';
+        if (fscanf(f, "%31s", type) != 1 || !strcmp(type, "Instruction")) {
+            fclose(f);
+            continue;
+        }
+        fclose(f);
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu0/cache/index%d/size", i);
+        if (!(f = fopen(path, "r"))) {
+            continue;
+        }
+        unit = 'K';
+        if (fscanf(f, "%lu%c", &size, &unit) < 1) {
+            size = 0;
+        }
+        fclose(f);
+        return size << (unit == 'M' ? 20 : unit == 'K' ? 10 : 0);
+    }
+    return 0;
+}
+
+/* Run fn over the region [0, bytes) of buf once for warmup, then reps
+   times, each time as often as needed to last BENCH_MIN_SECONDS, and print
+   the best time per word of traffic and bandwidth. */
+static void bench(const struct level *lv, const char *name, bench_fn fn,
+                  const void *arg) {
+    double start, seconds, best = 0;
+    unsigned long long traffic = 0;
+    unsigned long n, times = 1;
+    int r;
+
+    w.bytes_read = w.bytes_written = 0;
+    start = monotonic_seconds();
+    fn(&w, arg);
+    seconds = monotonic_seconds() - start;
+    if (seconds < BENCH_MIN_SECONDS) {
+        times = (unsigned long) (BENCH_MIN_SECONDS / (seconds + 1e-9)) + 1;
+    }
+    for (r = 0; r < reps; r++) {
+        w.bytes_read = w.bytes_written = 0;
+        start = monotonic_seconds();
+        for (n = 0; n < times; n++) {
+            fn(&w, arg);
+        }
+        seconds = (monotonic_seconds() - start) / times;
+        if (!r || seconds < best) {
+            best = seconds;
+        }
+        traffic = (w.bytes_read + w.bytes_written) / times;
+    }
+    printf("%-4s %8luK  %-22s %9.3f %9.2f\n", lv->name,
+           (ul) (lv->bytes >> 10), name,
+           traffic ? best * 1e9 / (traffic / sizeof(ul)) : 0,
+           best > 0 ? traffic / best / 1e9 : 0);
+}
+
+static void bench_memset(struct worker *wk, const void *arg) {
+    (void) arg;
+    memset((void *) wk->base, 0x5a, wk->bytes);
+    wk->bytes_written += wk->bytes;
+}
+
+static void bench_memcpy(struct worker *wk, const void *arg) {
+    (void) arg;
+    memcpy((void *) wk->bufb, (void *) wk->bufa, wk->count * sizeof(ul));
+    wk->bytes_read += wk->count * sizeof(ul);
+    wk->bytes_written += wk->count * sizeof(ul);
+}
+
+static void bench_compare(struct worker *wk, const void *arg) {
+    (void) arg;
+    if (compare_regions(wk->bufa, wk->bufb, wk->count)) {
+        fprintf(stderr, "compare_regions found a difference\n");
+    }
+}
+
+static void bench_test(struct worker *wk, const void *arg) {
+    const struct test *t = (const struct test *) arg;
+    int r;
+
+    rng_init(0);
+    if (verify_expected && (t->flags & TEST_PATTERN)) {
+        r = test_run(t, wk->base, NULL, wk->bytes / sizeof(ul));
+    } else {
+        r = test_run(t, wk->bufa, wk->bufb, wk->count);
+    }
+    if (r) {
+        fprintf(stderr, "%s failed\n", t->name);
+    }
+}
+
+int main(int argc, char **argv) {
+    struct level levels[LEVEL_MAX];
+    size_t dram = 256UL << 20, size;
+    char *kernels_name = NULL, *suffix;
+    int nontemporal = 0, nlevels = 0, opt, i;
+    void *buf;
+    struct test *t;
+
+    while ((opt = getopt(argc, argv, "k:ner:m:")) != -1) {
+        switch (opt) {
+            case 'k':
+                kernels_name = optarg;
+                break;
+            case 'n':
+                nontemporal = 1;
+                break;
+            case 'e':
+                verify_expected = 1;
+                break;
+            case 'r':
+                reps = atoi(optarg);
+                if (reps < 1) {
+                    return usage(argv[0]);
+                }
+                break;
+            case 'm':
+                dram = (size_t) strtoul(optarg, &suffix, 0);
+                switch (*suffix) {
+                    case 'G':
+                    case 'g':
+                        dram <<= 10;
+                        /* fall through */
+                    case 'M':
+                    case 'm':
+                    case '\0':
+                        dram <<= 10;
+                        /* fall through */
+                    case 'K':
+                    case 'k':
+                        dram <<= 10;
+                        break;
+                    default:
+                        return usage(argv[0]);
+                }
+                break;
+            default:
+                return usage(argv[0]);
+        }
+    }
+    if (kernels_select(kernels_name, nontemporal) < 0) {
+        return usage(argv[0]);
+    }
+    out_progress_disable();
+
+    /* Half of each cache, so the region stays in it; the DRAM region is
+       well past the last level. */
+    size = cache_size(1);
+    levels[nlevels].name = "L1";
+    levels[nlevels++].bytes = (size ? size : 32UL << 10) / 2;
+    size = cache_size(2);
+    levels[nlevels].name = "L2";
+    levels[nlevels++].bytes = (size ? size : 1UL << 20) / 2;
+    if ((size = cache_size(3))) {
+        levels[nlevels].name = "LLC";
+        levels[nlevels++].bytes = size / 2;
+    }
+    if (dram < size * 4) {
+        dram = size * 4;
+    }
+    levels[nlevels].name = "DRAM";
+    levels[nlevels++].bytes = dram;
+
+    buf = mmap(NULL, dram, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    memset(buf, 0, dram);
+    printf("using %s kernels%s%s, best of %d\n", kern->name,
+           nontemporal ? " with non-temporal stores" : "",
+           verify_expected ? ", --verify=expected" : "", reps);
+    printf("%-4s %9s  %-22s %9s %9s\n", "", "size", "", "ns/word",
+           "GB/s");
+
+    /* A single worker on the main thread, so the tests count their
+       traffic; pattern tests stop after BENCH_PASSES passes. */
+    cur_worker = &w;
+    w.slice = &w;
+    w.node = -1;
+    w.pass_first = 0;
+    w.pass_end = BENCH_PASSES;
+    for (i = 0; i < nlevels; i++) {
+        size = levels[i].bytes & ~(2 * sizeof(ul) - 1);
+        w.base = w.bufa = (ulv *) buf;
+        w.bytes = size;
+        w.count = size / 2 / sizeof(ul);
+        w.bufb = w.bufa + w.count;
+        bench(&levels[i], "memset", bench_memset, NULL);
+        bench(&levels[i], "memcpy", bench_memcpy, NULL);
+        memset(buf, 0, size);
+        bench(&levels[i], "compare_regions", bench_compare, NULL);
+        for (t = tests; t->name; t++) {
+            bench(&levels[i], t->name, bench_test, t);
+        }
+    }
+    cur_worker = NULL;
+    munmap(buf, dram);
+    return 0;
+}
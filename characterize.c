@@ -0,0 +1,261 @@
+/*
+ * Very simple but very effective user-space memory tester.
+ * Originally by Simon Kirby <sim@stormix.com> <sim@neato.org>
+ * Version 2 by Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Version 3 not publicly released.
+ * Version 4 rewrite:
+ * Copyright (C) 2004-2020 Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains the characterization pass run before testing with
+ * --characterize, to tell memory which is merely slow (a channel running
+ * degraded, mixed-speed DIMMs) from memory which works at full speed.  It
+ * measures the latency of a random pointer chase at working sets from 16K
+ * up to a worker's slice, then read, write and copy bandwidth with 1, 2,
+ * 4... and all workers; in NUMA mode, it does both again for each node's
+ * memory from that node's own workers.  Everything runs in the workers'
+ * slices of the buffer under test, which it overwrites, using the selected
+ * kernels for reads and writes.
+ *
+ */
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "types.h"
+#include "sizes.h"
+#include "threads.h"
+#include "kernels.h"
+#include "output.h"
+#include "rng.h"
+#include "characterize.h"
+
+enum { BW_WRITE, BW_READ, BW_COPY, BW_KINDS };
+
+static const char *bw_names[BW_KINDS] = { "Write", "Read", "Copy" };
+
+/* What the workers are asked to do: a chase of set bytes by target, or
+   bandwidth of the given kind by the workers numbered below threads (or,
+   if threads is 0, by those on node). */
+struct char_job {
+    struct worker *target;
+    size_t set;
+    double ns;
+    int kind;
+    unsigned int threads;
+    int node;
+};
+
+/* Print one figure and write its record, with loop 0 so that it can be told
+   from the test results. */
+static void report(const char *label, int node, double ns,
+                   unsigned long long rd, unsigned long long wr,
+                   double seconds) {
+    struct test_result r;
+
+    if (ns > 0) {
+        printf("  %-20s: %.1f ns\n", label, ns);
+    } else {
+        printf("  %-20s: %.2f GB/s\n", label,
+               seconds > 0 ? (double) (rd + wr) / seconds / 1e9 : 0);
+    }
+    fflush(stdout);
+    r.loop = 0;
+    r.test = label;
+    r.order = ns > 0 ? "chase" : "linear";
+    r.thread = -1;
+    r.node = node;
+    r.failed = 0;
+    r.errors = 0;
+    r.bytes_read = rd;
+    r.bytes_written = wr;
+    r.activations = 0;
+    r.latency_ns = ns;
+    r.corrected = 0;
+    r.seconds = seconds;
+    out_report(&r);
+}
+
+/* Line k of a chase in the slice at base. */
+static ulv *line(char *base, size_t k) {
+    return (ulv *) (base + k * CHAR_LINE);
+}
+
+/*
+ * Link the first job->set bytes of the target's slice into one random
+ * cycle of cache lines and time CHAR_LOADS loads along it.  The shuffle is
+ * done in place: the first word of line k holds the k-th line visited, and
+ * the second word of each line points to the second word of the next.
+ */
+static int chase_job(struct worker *w, void *arg) {
+    struct char_job *job = (struct char_job *) arg;
+    size_t lines = job->set / CHAR_LINE, i, j, t;
+    char *base = (char *) w->base;
+    double start;
+    ul p, n;
+
+    if (w != job->target) {
+        return 0;
+    }
+    rng_init(job->set);
+    for (i = 0; i < lines; i++) {
+        line(base, i)[0] = i;
+    }
+    for (i = lines - 1; i > 0; i--) {
+        j = rand_ul() % (i + 1);
+        t = line(base, i)[0];
+        line(base, i)[0] = line(base, j)[0];
+        line(base, j)[0] = t;
+    }
+    for (i = 0; i < lines; i++) {
+        line(base, line(base, i)[0])[1] =
+            (ul) (line(base, line(base, (i + 1) % lines)[0]) + 1);
+    }
+    p = (ul) (line(base, line(base, 0)[0]) + 1);
+    /* Warm the caches and TLB up with one round first. */
+    for (n = 0; n < lines; n++) {
+        p = *(ulv *) p;
+    }
+    start = monotonic_seconds();
+    for (n = 0; n < CHAR_LOADS; n += 8) {
+        p = *(ulv *) p;
+        p = *(ulv *) p;
+        p = *(ulv *) p;
+        p = *(ulv *) p;
+        p = *(ulv *) p;
+        p = *(ulv *) p;
+        p = *(ulv *) p;
+        p = *(ulv *) p;
+    }
+    job->ns = (monotonic_seconds() - start) * 1e9 / CHAR_LOADS;
+    return 0;
+}
+
+static int takes_part(const struct worker *w, const struct char_job *job) {
+    return job->threads ? w->id < job->threads : w->node == job->node;
+}
+
+/* Write, read or copy the worker's slice CHAR_PASSES times over. */
+static int bandwidth_job(struct worker *w, void *arg) {
+    struct char_job *job = (struct char_job *) arg;
+    size_t words = w->bytes / sizeof(ul);
+    unsigned int pass;
+
+    if (!takes_part(w, job)) {
+        return 0;
+    }
+    for (pass = 0; pass < CHAR_PASSES; pass++) {
+        switch (job->kind) {
+            case BW_WRITE:
+                kern->fill_one(w->base, words, 0, 0);
+                break;
+            case BW_READ:
+                (void) kern->xor_all(w->base, words);
+                break;
+            case BW_COPY:
+                memcpy((void *) w->bufb, (void *) w->bufa,
+                       w->count * sizeof(ul));
+                break;
+        }
+    }
+    return 0;
+}
+
+/* Measure every kind of bandwidth with the workers job selects. */
+static void bandwidths(struct char_job *job, const char *suffix) {
+    unsigned long long rd, wr;
+    struct worker *w;
+    unsigned int i;
+    char label[64];
+    double start, seconds;
+
+    for (job->kind = 0; job->kind < BW_KINDS; job->kind++) {
+        rd = wr = 0;
+        for (i = 0; i < workers_count(); i++) {
+            w = workers_get(i);
+            if (!takes_part(w, job)) {
+                continue;
+            }
+            if (job->kind != BW_WRITE) {
+                rd += (ull) CHAR_PASSES * (job->kind == BW_COPY ?
+                    w->count * sizeof(ul) : w->bytes);
+            }
+            if (job->kind != BW_READ) {
+                wr += (ull) CHAR_PASSES * (job->kind == BW_COPY ?
+                    w->count * sizeof(ul) : w->bytes);
+            }
+        }
+        start = monotonic_seconds();
+        workers_run(bandwidth_job, job);
+        seconds = monotonic_seconds() - start;
+        snprintf(label, sizeof(label), "%s%s", bw_names[job->kind], suffix);
+        report(label, job->threads ? -1 : job->node, 0, rd, wr, seconds);
+    }
+}
+
+/* Chase working sets in the slice of w, which is on node (or -1). */
+static void latencies(struct worker *w, int node) {
+    struct char_job job;
+    char label[64];
+    size_t set;
+    int n;
+
+    memset(&job, 0, sizeof(job));
+    job.target = w;
+    for (set = CHAR_MIN_SET; set <= w->bytes; set *= CHAR_SET_STEP) {
+        job.set = set;
+        workers_run(chase_job, &job);
+        n = snprintf(label, sizeof(label), "Latency %lu%c",
+                     (ul) (set >= (1UL << 30) ? set >> 30 :
+                           set >= (1UL << 20) ? set >> 20 : set >> 10),
+                     set >= (1UL << 30) ? 'G' : set >= (1UL << 20) ? 'M'
+                                                                   : 'K');
+        if (node >= 0) {
+            snprintf(label + n, sizeof(label) - n, " node %d", node);
+        }
+        report(label, node, job.ns, (ull) CHAR_LOADS * sizeof(ul), 0,
+               job.ns * CHAR_LOADS / 1e9);
+    }
+}
+
+/* Run the whole characterization pass on the workers' slices, printing
+   what it finds. */
+void characterize_run(void) {
+    unsigned int n = workers_count(), t, i, j;
+    struct char_job job;
+    struct worker *w;
+    char suffix[32];
+
+    printf("Characterization:\n");
+    latencies(workers_get(0), -1);
+    memset(&job, 0, sizeof(job));
+    for (t = 1; t <= n; t = (t < n && t * 2 > n) ? n : t * 2) {
+        job.threads = t;
+        snprintf(suffix, sizeof(suffix), " x%u", t);
+        bandwidths(&job, suffix);
+        if (t == n) {
+            break;
+        }
+    }
+    /* Each node from its own workers, the first one of which chases. */
+    for (i = 0; i < n; i++) {
+        w = workers_get(i);
+        if (w->node < 0) {
+            continue;
+        }
+        for (j = 0; j < i && workers_get(j)->node != w->node; j++)
+            ;
+        if (j < i) {
+            continue;
+        }
+        latencies(w, w->node);
+        job.threads = 0;
+        job.node = w->node;
+        snprintf(suffix, sizeof(suffix), " node %d", w->node);
+        bandwidths(&job, suffix);
+    }
+    printf("\n");
+    fflush(stdout);
+}
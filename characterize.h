@@ -0,0 +1,26 @@
+/*
+ * Very simple but very effective user-space memory tester.
+ * Originally by Simon Kirby <sim@stormix.com> <sim@neato.org>
+ * Version 2 by Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Version 3 not publicly released.
+ * Version 4 rewrite:
+ * Copyright (C) 2004-2020 Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains the declarations for the characterization pass.
+ *
+ */
+
+#ifndef _CHARACTERIZE_H_
+#define _CHARACTERIZE_H_
+
+#define CHAR_LINE 64                /* bytes between pointers of a chase */
+#define CHAR_MIN_SET (16UL << 10)   /* smallest working set chased */
+#define CHAR_SET_STEP 8             /* growth from one working set to the next */
+#define CHAR_LOADS (1UL << 22)      /* loads timed per working set */
+#define CHAR_PASSES 4               /* passes over each slice per bandwidth */
+
+void characterize_run(void);
+
+#endif /* _CHARACTERIZE_H_ */
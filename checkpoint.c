@@ -0,0 +1,149 @@
+/*
+ * Very simple but very effective user-space memory tester.
+ * Originally by Simon Kirby <sim@stormix.com> <sim@neato.org>
+ * Version 2 by Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Version 3 not publicly released.
+ * Version 4 rewrite:
+ * Copyright (C) 2004-2020 Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains the checkpoint file behind --checkpoint and --resume.
+ * It is a few "key value" lines describing the run and the next chunk to
+ * test.  It is rewritten after every chunk through a temporary file and
+ * rename(2), so a crash or preemption leaves either the old or the new
+ * checkpoint, never a torn one.
+ *
+ */
+
+#include <sys/types.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "checkpoint.h"
+
+#define CHECKPOINT_MAGIC "memtester-checkpoint 1"
+
+int checkpoint_save(const char *path, const struct checkpoint *c) {
+    char tmp[PATH_MAX + sizeof(".tmp")];
+    FILE *file;
+    int r;
+
+    r = snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    if (r < 0 || (size_t) r >= sizeof(tmp)) {
+        fprintf(stderr, "%s: path too long\n", path);
+        return -1;
+    }
+    if (!(file = fopen(tmp, "w"))) {
+        perror(tmp);
+        return -1;
+    }
+    fprintf(file, CHECKPOINT_MAGIC "\n"
+            "seed 0x%llx\nbytes %llu\nbufsize %llu\nlayout 0x%llx\n"
+            "threads %u\nchunk %llu\n"
+            "testmask 0x%lx\ntests %s\norders %s\nverify_expected %d\n"
+            "loop %lu\ntest %lu\nrepeat %lu\norder %lu\nnext_chunk %lu\n"
+            "exit_code %d\n",
+            c->seed, c->bytes, c->bufsize, c->layout, c->threads, c->chunk, c->testmask,
+            c->tests[0] ? c->tests : "-", c->orders, c->verify_expected,
+            c->loop, c->test, c->repeat, c->order, c->next_chunk,
+            c->exit_code);
+    r = fflush(file) == 0 && fsync(fileno(file)) == 0;
+    if (fclose(file) != 0 || !r || rename(tmp, path) != 0) {
+        perror(path);
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+/* Returns 0 if loaded, 1 if there is no checkpoint, -1 if it is bad. */
+int checkpoint_load(const char *path, struct checkpoint *c) {
+    char line[256], key[32], value[160];
+    FILE *file;
+    int n = 0, r, bad = 0;
+
+    if (!(file = fopen(path, "r"))) {
+        if (errno == ENOENT) {
+            return 1;
+        }
+        perror(path);
+        return -1;
+    }
+    memset(c, 0, sizeof(*c));
+    if (!fgets(line, sizeof(line), file) ||
+        strncmp(line, CHECKPOINT_MAGIC, strlen(CHECKPOINT_MAGIC))) {
+        fprintf(stderr, "%s is not a memtester checkpoint\n", path);
+        fclose(file);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), file)) {
+        if (sscanf(line, "%31s %159s", key, value) != 2) {
+            continue;
+        }
+        n++;
+        if (!strcmp(key, "seed")) {
+            sscanf(value, "%llx", &c->seed);
+        } else if (!strcmp(key, "bytes")) {
+            sscanf(value, "%llu", &c->bytes);
+        } else if (!strcmp(key, "bufsize")) {
+            sscanf(value, "%llu", &c->bufsize);
+        } else if (!strcmp(key, "layout")) {
+            sscanf(value, "%llx", &c->layout);
+        } else if (!strcmp(key, "threads")) {
+            sscanf(value, "%u", &c->threads);
+        } else if (!strcmp(key, "chunk")) {
+            sscanf(value, "%llu", &c->chunk);
+        } else if (!strcmp(key, "testmask")) {
+            sscanf(value, "%lx", &c->testmask);
+        } else if (!strcmp(key, "tests")) {
+            r = snprintf(c->tests, sizeof(c->tests), "%s",
+                         strcmp(value, "-") ? value : "");
+            bad |= r < 0 || (size_t) r >= sizeof(c->tests);
+        } else if (!strcmp(key, "orders")) {
+            r = snprintf(c->orders, sizeof(c->orders), "%s", value);
+            bad |= r < 0 || (size_t) r >= sizeof(c->orders);
+        } else if (!strcmp(key, "verify_expected")) {
+            sscanf(value, "%d", &c->verify_expected);
+        } else if (!strcmp(key, "loop")) {
+            sscanf(value, "%lu", &c->loop);
+        } else if (!strcmp(key, "test")) {
+            sscanf(value, "%lu", &c->test);
+        } else if (!strcmp(key, "repeat")) {
+            sscanf(value, "%lu", &c->repeat);
+        } else if (!strcmp(key, "order")) {
+            sscanf(value, "%lu", &c->order);
+        } else if (!strcmp(key, "next_chunk")) {
+            sscanf(value, "%lu", &c->next_chunk);
+        } else if (!strcmp(key, "exit_code")) {
+            sscanf(value, "%d", &c->exit_code);
+        } else {
+            n--;
+        }
+    }
+    fclose(file);
+    if (bad) {
+        /* Longer than any list memtester saves. */
+        fprintf(stderr, "%s: bad checkpoint\n", path);
+        return -1;
+    }
+    if (n != 16 || !c->loop) {
+        fprintf(stderr, "%s: incomplete checkpoint\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+/* Whether a and b describe the same run, so one can resume the other. */
+int checkpoint_same_run(const struct checkpoint *a,
+                        const struct checkpoint *b) {
+    return a->bytes == b->bytes && a->bufsize == b->bufsize &&
+        a->layout == b->layout && a->threads == b->threads &&
+        a->chunk == b->chunk && a->testmask == b->testmask &&
+        !strcmp(a->tests, b->tests) &&
+        a->verify_expected == b->verify_expected &&
+        !strcmp(a->orders, b->orders);
+}
@@ -0,0 +1,45 @@
+/*
+ * Very simple but very effective user-space memory tester.
+ * Originally by Simon Kirby <sim@stormix.com> <sim@neato.org>
+ * Version 2 by Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Version 3 not publicly released.
+ * Version 4 rewrite:
+ * Copyright (C) 2004-2020 Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains the declarations for checkpoints (--checkpoint).
+ *
+ */
+
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_
+
+#define CHECKPOINT_CHUNK (256UL << 20)  /* default --chunk with --checkpoint */
+
+struct checkpoint {
+    /* The run; a checkpoint only resumes the same one. */
+    unsigned long long seed;
+    unsigned long long bytes;           /* memory asked for */
+    unsigned long long bufsize;         /* and got */
+    unsigned long long layout;          /* of the slices, hashed */
+    unsigned int threads;
+    unsigned long long chunk;           /* bytes per chunk, 0 for none */
+    unsigned long testmask;
+    char tests[128];                    /* --tests, or empty */
+    char orders[128];
+    int verify_expected;
+    /* Where it got to: the next chunk to run. */
+    unsigned long loop;
+    unsigned long test;                 /* step in the --tests list */
+    unsigned long repeat;
+    unsigned long order;
+    unsigned long next_chunk;
+    int exit_code;                      /* failures found so far */
+};
+
+int checkpoint_save(const char *path, const struct checkpoint *c);
+int checkpoint_load(const char *path, struct checkpoint *c);
+int checkpoint_same_run(const struct checkpoint *a, const struct checkpoint *b);
+
+#endif /* _CHECKPOINT_H_ */
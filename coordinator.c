@@ -0,0 +1,429 @@
+/*
+ * Very simple but very effective user-space memory tester.
+ * Originally by Simon Kirby <sim@stormix.com> <sim@neato.org>
+ * Version 2 by Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Version 3 not publicly released.
+ * Version 4 rewrite:
+ * Copyright (C) 2004-2020 Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains the coordinator (--processes), which tests memory
+ * with several processes instead of one: one per NUMA node, per -p range,
+ * or per share of <mem>.  coordinator_start() forks them, and each goes
+ * on to allocate and test its own memory as memtester always does, its
+ * output and its result records (in CSV) going to the coordinator over a
+ * pipe each.  coordinator_wait() prints their output, each line marked
+ * with the process it came from, merges their records into one report in
+ * the format asked for, and once they are all done, prints what each
+ * found and exits with all their exit codes ORed together.  The processes
+ * share nothing, so one which is OOM-killed or takes a fault dies alone,
+ * and the others test on; coordinator_wait() starts it again, a few times
+ * at most, so that its share of memory is tested all the same.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "memtester.h"
+#include "coordinator.h"
+#include "output.h"
+
+#define COORD_LINE 4096         /* longest line passed on whole */
+#define COORD_FIELDS 32         /* of a record */
+#define COORD_RESTARTS 3        /* of each process killed by a signal */
+
+enum { FROM_OUTPUT, FROM_RECORDS };
+
+/* One process, as its coordinator sees it. */
+struct process {
+    pid_t pid;
+    char label[COORD_LABEL];
+    int fd[2];                      /* its output and records, or -1 */
+    char line[2][COORD_LINE];       /* what came of their last line */
+    size_t len[2];
+    int status;                     /* from waitpid(), once it is done */
+    unsigned int restarts;
+    int restart_sig;                /* that killed it the last time */
+    unsigned long long tests;       /* from its records */
+    unsigned long long failed;
+    unsigned long long errors;
+};
+
+static struct process procs[COORD_MAX];
+static unsigned int n_procs;
+static size_t share;                /* bytes tested by each process */
+static volatile sig_atomic_t stopping;
+static char header[COORD_LINE];     /* the column names of the records */
+static char *names[COORD_FIELDS];
+static unsigned int n_names;
+
+/* memtester is stopped with SIGTERM by service managers, which only send
+   it to the coordinator. */
+static void forward_signal(int sig) {
+    unsigned int i;
+
+    stopping = 1;
+    for (i = 0; i < n_procs; i++) {
+        if (procs[i].pid > 0) {
+            kill(procs[i].pid, sig);
+        }
+    }
+}
+
+/* Fork process i.  Returns 0 in it, with its output going to the
+   coordinator and *records the descriptor to write its records to, 1 in
+   the coordinator, or -1 if it could not be started. */
+static int spawn(unsigned int i, int *records) {
+    int out[2], rec[2];
+    unsigned int j;
+    pid_t pid;
+
+    fflush(stdout);
+    fflush(stderr);
+    if (pipe(out) < 0) {
+        perror("pipe");
+        return -1;
+    }
+    if (pipe(rec) < 0) {
+        perror("pipe");
+        close(out[0]);
+        close(out[1]);
+        return -1;
+    }
+    if ((pid = fork()) < 0) {
+        perror("fork");
+        close(out[0]);
+        close(out[1]);
+        close(rec[0]);
+        close(rec[1]);
+        return -1;
+    }
+    if (!pid) {
+        for (j = 0; j < n_procs; j++) {
+            if (procs[j].fd[FROM_OUTPUT] >= 0) {
+                close(procs[j].fd[FROM_OUTPUT]);
+            }
+            if (procs[j].fd[FROM_RECORDS] >= 0) {
+                close(procs[j].fd[FROM_RECORDS]);
+            }
+        }
+        n_procs = 0;
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        close(out[0]);
+        close(rec[0]);
+        dup2(out[1], STDOUT_FILENO);
+        dup2(out[1], STDERR_FILENO);
+        close(out[1]);
+        *records = rec[1];
+        return 0;
+    }
+    close(out[1]);
+    close(rec[1]);
+    procs[i].pid = pid;
+    procs[i].fd[FROM_OUTPUT] = out[0];
+    procs[i].fd[FROM_RECORDS] = rec[0];
+    procs[i].len[FROM_OUTPUT] = procs[i].len[FROM_RECORDS] = 0;
+    return 1;
+}
+
+/* Fork n processes, each testing bytes of memory.  Returns the index of
+   the process in each of them, with its output going to the coordinator
+   and *records the descriptor to write its records to, and n in the
+   coordinator itself; or -1 if they could not all be started, after
+   stopping those which were. */
+int coordinator_start(unsigned int n, char labels[][COORD_LABEL],
+                      size_t bytes, int *records) {
+    unsigned int i;
+    int r = 1;
+
+    share = bytes;
+    for (i = 0; i < n && i < COORD_MAX; i++) {
+        snprintf(procs[i].label, sizeof(procs[i].label), "%s", labels[i]);
+        if ((r = spawn(i, records)) <= 0) {
+            break;
+        }
+        n_procs = i + 1;
+    }
+    if (!r) {
+        return (int) i;
+    }
+    if (i < n) {
+        forward_signal(SIGTERM);
+        return -1;
+    }
+    return (int) n;
+}
+
+/* Cut line at its commas into at most max fields. */
+static unsigned int split(char *line, char **fields, unsigned int max) {
+    unsigned int n = 0;
+
+    while (n < max) {
+        fields[n++] = line;
+        if (!(line = strchr(line, ','))) {
+            break;
+        }
+        *line++ = '\0';
+    }
+    return n;
+}
+
+/* The field of a record with the given column name, or "". */
+static const char *field(char **fields, unsigned int n, const char *name) {
+    unsigned int i;
+
+    for (i = 0; i < n && i < n_names; i++) {
+        if (!strcmp(names[i], name)) {
+            return fields[i];
+        }
+    }
+    return "";
+}
+
+static int is_number(const char *s) {
+    char *end;
+
+    if (!*s || (*s != '-' && (*s < '0' || *s > '9'))) {
+        return 0;
+    }
+    strtod(s, &end);
+    return !*end;
+}
+
+/* Count a record of process k in, and write it to the report, with the
+   process it came from in front. */
+static void take_record(unsigned int k, char *line, FILE *report, int json) {
+    struct process *p = &procs[k];
+    char copy[COORD_LINE];
+    char *fields[COORD_FIELDS];
+    unsigned int n, i;
+
+    if (!strncmp(line, "loop,", 5)) {
+        if (!n_names) {
+            snprintf(header, sizeof(header), "%s", line);
+            n_names = split(header, names, COORD_FIELDS);
+            if (report && !json) {
+                fprintf(report, "process,%s\n", line);
+            }
+        }
+        return;
+    }
+    snprintf(copy, sizeof(copy), "%s", line);
+    n = split(copy, fields, COORD_FIELDS);
+    /* Only the records for all threads of a test, not --characterize's. */
+    if (!strcmp(field(fields, n, "thread"), "-1") &&
+        strcmp(field(fields, n, "loop"), "0")) {
+        p->tests++;
+        p->failed += !strcmp(field(fields, n, "result"), "fail");
+        p->errors += strtoull(field(fields, n, "errors"), NULL, 10);
+    }
+    if (!report) {
+        return;
+    }
+    if (json) {
+        fprintf(report, "{\"process\": %u", k);
+        for (i = 0; i < n && i < n_names; i++) {
+            fprintf(report, is_number(fields[i]) ? ", \"%s\": %s"
+                                                 : ", \"%s\": \"%s\"",
+                    names[i], fields[i]);
+        }
+        fprintf(report, "}\n");
+    } else {
+        fprintf(report, "%u,%s\n", k, line);
+    }
+    fflush(report);
+}
+
+static void take_line(unsigned int k, int from, char *line, FILE *report,
+                      int json) {
+    if (from == FROM_RECORDS) {
+        take_record(k, line, report, json);
+    } else {
+        printf("[%s] %s\n", procs[k].label, line);
+        fflush(stdout);
+    }
+}
+
+/* Read what there is from one pipe of process k and pass on every whole
+   line; returns 0 at the end of it. */
+static int take(unsigned int k, int from, FILE *report, int json) {
+    struct process *p = &procs[k];
+    char *buf = p->line[from], *nl, *start;
+    size_t *len = &p->len[from];
+    ssize_t n;
+
+    if (*len == COORD_LINE - 1) {
+        /* Too long; pass on what there is of it. */
+        buf[*len] = '\0';
+        take_line(k, from, buf, report, json);
+        *len = 0;
+    }
+    n = read(p->fd[from], buf + *len, COORD_LINE - 1 - *len);
+    if (n < 0 && errno == EINTR) {
+        return 1;
+    }
+    if (n <= 0) {
+        if (*len) {
+            buf[*len] = '\0';
+            take_line(k, from, buf, report, json);
+            *len = 0;
+        }
+        return 0;
+    }
+    *len += n;
+    buf[*len] = '\0';
+    for (start = buf; (nl = strchr(start, '\n')); start = nl + 1) {
+        *nl = '\0';
+        take_line(k, from, start, report, json);
+    }
+    *len -= start - buf;
+    memmove(buf, start, *len);
+    return 1;
+}
+
+/* Reap process k, whose output and records have both ended, adding its
+   exit code to *code, and start it again if it was killed by a signal
+   other than one to stop it.  Returns 0 in the restarted process, as
+   spawn() does, and 1 in the coordinator. */
+static int reap(unsigned int k, int *records, int *code) {
+    struct process *p = &procs[k];
+    int sig, r;
+
+    while (waitpid(p->pid, &p->status, 0) < 0 && errno == EINTR)
+        ;
+    p->pid = 0;
+    if (!WIFSIGNALED(p->status)) {
+        *code |= WEXITSTATUS(p->status);
+        return 1;
+    }
+    sig = WTERMSIG(p->status);
+    /* SIGBUS is what a memory error the kernel can't correct gets; that
+       memory failed whether or not a restart tests it through. */
+    if (sig == SIGBUS) {
+        *code |= EXIT_FAIL_OTHERTEST;
+    }
+    if (!stopping && sig != SIGINT && sig != SIGTERM &&
+        p->restarts < COORD_RESTARTS) {
+        printf("coordinator: %s killed by signal %d (%s), restarting it\n",
+               p->label, sig, strsignal(sig));
+        if ((r = spawn(k, records)) >= 0) {
+            p->restarts++;
+            p->restart_sig = sig;
+            return r;
+        }
+    }
+    /* Anything else means the process couldn't test. */
+    *code |= EXIT_FAIL_NONSTARTER;
+    return 1;
+}
+
+/* In the coordinator, pass on the output and records of the processes
+   until they are all done, restarting those killed on the way, write the
+   report in format ("json" or "csv", or none) to path (or stdout), and
+   print what each found.  Returns -1 in the coordinator, with the exit code
+   of the run in *code; or, in a process it restarted, the index of the
+   process and *records as coordinator_start() does. */
+int coordinator_wait(const char *format, const char *path, int *records,
+                     int *code) {
+    struct pollfd fds[2 * COORD_MAX];
+    unsigned int who[2 * COORD_MAX];
+    int from[2 * COORD_MAX];
+    struct process *p;
+    FILE *report = NULL;
+    int json = 0, sig;
+    unsigned int i, n;
+
+    /* The terminal sends SIGINT to the processes already. */
+    signal(SIGINT, SIG_IGN);
+    signal(SIGTERM, forward_signal);
+    *code = 0;
+    if (format && strcmp(format, "text")) {
+        json = !strcmp(format, "json");
+        if (!path || !strcmp(path, "-")) {
+            report = out_records_stdout();
+        } else if (!(report = fopen(path, "w"))) {
+            perror(path);
+            *code |= EXIT_FAIL_NONSTARTER;
+        }
+    }
+    for (;;) {
+        for (i = 0, n = 0; i < n_procs; i++) {
+            if (procs[i].fd[FROM_OUTPUT] >= 0) {
+                fds[n].fd = procs[i].fd[FROM_OUTPUT];
+                fds[n].events = POLLIN;
+                who[n] = i;
+                from[n++] = FROM_OUTPUT;
+            }
+            if (procs[i].fd[FROM_RECORDS] >= 0) {
+                fds[n].fd = procs[i].fd[FROM_RECORDS];
+                fds[n].events = POLLIN;
+                who[n] = i;
+                from[n++] = FROM_RECORDS;
+            }
+        }
+        if (!n) {
+            break;
+        }
+        if (poll(fds, n, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("poll");
+            break;
+        }
+        for (i = 0; i < n; i++) {
+            if (fds[i].revents && !take(who[i], from[i], report, json)) {
+                close(fds[i].fd);
+                procs[who[i]].fd[from[i]] = -1;
+            }
+        }
+        for (i = 0; i < n_procs; i++) {
+            p = &procs[i];
+            if (p->pid > 0 && p->fd[FROM_OUTPUT] < 0 &&
+                p->fd[FROM_RECORDS] < 0 && !reap(i, records, code)) {
+                return (int) i;
+            }
+        }
+    }
+    printf("coordinator: %u processes done:\n", n_procs);
+    for (i = 0; i < n_procs; i++) {
+        p = &procs[i];
+        if (p->pid > 0 && !reap(i, records, code)) {
+            return (int) i;
+        }
+        printf("  %-12s: %llu tests, %llu failed, %llu errors, ", p->label,
+               p->tests, p->failed, p->errors);
+        if (WIFSIGNALED(p->status)) {
+            sig = WTERMSIG(p->status);
+            printf("killed by signal %d (%s)", sig, strsignal(sig));
+            if (sig != SIGINT && sig != SIGTERM) {
+                printf(", %lluMB left untested",
+                       (unsigned long long) share >> 20);
+            }
+        } else {
+            printf("exit code %d", WEXITSTATUS(p->status));
+        }
+        if (p->restarts) {
+            printf(" (restarted %u time%s, last after signal %d)",
+                   p->restarts, p->restarts == 1 ? "" : "s", p->restart_sig);
+        }
+        printf("\n");
+    }
+    if (report && path && strcmp(path, "-")) {
+        fclose(report);
+    }
+    fflush(stdout);
+    return -1;
+}
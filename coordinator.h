@@ -0,0 +1,28 @@
+/*
+ * Very simple but very effective user-space memory tester.
+ * Originally by Simon Kirby <sim@stormix.com> <sim@neato.org>
+ * Version 2 by Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Version 3 not publicly released.
+ * Version 4 rewrite:
+ * Copyright (C) 2004-2020 Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains the declarations for the coordinator (--processes).
+ *
+ */
+
+#ifndef _COORDINATOR_H_
+#define _COORDINATOR_H_
+
+#include <stddef.h>
+
+#define COORD_MAX 64            /* processes */
+#define COORD_LABEL 32
+
+int coordinator_start(unsigned int n, char labels[][COORD_LABEL],
+                      size_t bytes, int *records);
+int coordinator_wait(const char *format, const char *path, int *records,
+                     int *code);
+
+#endif /* _COORDINATOR_H_ */
@@ -0,0 +1,209 @@
+/*
+ * Very simple but very effective user-space memory tester.
+ * Originally by Simon Kirby <sim@stormix.com> <sim@neato.org>
+ * Version 2 by Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Version 3 not publicly released.
+ * Version 4 rewrite:
+ * Copyright (C) 2004-2020 Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains the corrected error counters of EDAC (--ecc).  Errors
+ * which ECC corrects never reach the tests, but are the first sign of a
+ * failing DIMM.  edac_init() finds the ce_count of every memory controller
+ * under EDAC_SYSFS, and the counters of its DIMMs (dimm* or rank*, or
+ * csrow*'s ch*_ce_count on older kernels) with their labels; the counters
+ * are read once before each test and once after, never while it runs, and
+ * edac_end_test() prints what went up, by DIMM.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <sys/types.h>
+#include <dirent.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "edac.h"
+
+#define EDAC_PATH 256
+#define EDAC_LABEL 64
+
+struct edac_counter {
+    char path[EDAC_PATH];
+    char label[EDAC_LABEL];
+    int dimm;                   /* 0 for a memory controller's total */
+    unsigned long long before;
+};
+
+static struct edac_counter counters[EDAC_COUNTERS];
+static unsigned int n_counters;
+
+static int read_count(const char *path, unsigned long long *count) {
+    FILE *f = fopen(path, "r");
+    int r;
+
+    if (!f) {
+        return -1;
+    }
+    r = fscanf(f, "%llu", count) == 1 ? 0 : -1;
+    fclose(f);
+    return r;
+}
+
+/* Read a label, or leave the default if there is none. */
+static void read_label(const char *path, char *label) {
+    char line[EDAC_LABEL];
+    FILE *f = fopen(path, "r");
+
+    if (!f) {
+        return;
+    }
+    if (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\n")] = '\0';
+        if (line[0]) {
+            strcpy(label, line);
+        }
+    }
+    fclose(f);
+}
+
+/* snprintf() to buf, which holds len bytes; returns -1 if it doesn't all
+   fit, for paths of sysfs entries too long to read. */
+static int format(char *buf, size_t len, const char *fmt, ...) {
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = vsnprintf(buf, len, fmt, ap);
+    va_end(ap);
+    return n < 0 || (size_t) n >= len ? -1 : 0;
+}
+
+/* Watch the counter at path, if there is one; returns -1 if there isn't. */
+static int add_counter(const char *path, const char *label, int dimm) {
+    struct edac_counter *c;
+    unsigned long long count;
+
+    if (n_counters == EDAC_COUNTERS || read_count(path, &count) < 0) {
+        return -1;
+    }
+    c = &counters[n_counters++];
+    snprintf(c->path, sizeof(c->path), "%s", path);
+    snprintf(c->label, sizeof(c->label), "%s", label);
+    c->dimm = dimm;
+    c->before = count;
+    return 0;
+}
+
+/* The DIMMs (or ranks) of memory controller mc, or if it has none, the
+   channels of its chip-select rows. */
+static void add_dimms(const char *mc) {
+    char dir[EDAC_PATH], path[EDAC_PATH], label[EDAC_LABEL];
+    struct dirent *entry;
+    unsigned int ch, found = 0;
+    DIR *d;
+
+    if (format(dir, sizeof(dir), "%s/%s", EDAC_SYSFS, mc) < 0 ||
+        !(d = opendir(dir))) {
+        return;
+    }
+    while ((entry = readdir(d))) {
+        if (!strncmp(entry->d_name, "dimm", 4) ||
+            !strncmp(entry->d_name, "rank", 4)) {
+            /* A label cut short still tells the DIMMs apart. */
+            format(label, sizeof(label), "%s/%s", mc, entry->d_name);
+            if (!format(path, sizeof(path), "%s/%s/dimm_label", dir,
+                        entry->d_name)) {
+                read_label(path, label);
+            }
+            if (!format(path, sizeof(path), "%s/%s/dimm_ce_count", dir,
+                        entry->d_name)) {
+                add_counter(path, label, 1);
+            }
+            found++;
+        }
+    }
+    rewinddir(d);
+    while (!found && (entry = readdir(d))) {
+        if (strncmp(entry->d_name, "csrow", 5)) {
+            continue;
+        }
+        for (ch = 0; ch < 16; ch++) {
+            format(label, sizeof(label), "%s/%s/ch%u", mc, entry->d_name,
+                   ch);
+            if (!format(path, sizeof(path), "%s/%s/ch%u_dimm_label", dir,
+                        entry->d_name, ch)) {
+                read_label(path, label);
+            }
+            if (!format(path, sizeof(path), "%s/%s/ch%u_ce_count", dir,
+                        entry->d_name, ch)) {
+                add_counter(path, label, 1);
+            }
+        }
+    }
+    closedir(d);
+}
+
+/* Find the counters; returns how many memory controllers have them. */
+unsigned int edac_init(void) {
+    char path[EDAC_PATH];
+    struct dirent *entry;
+    unsigned int mcs = 0;
+    DIR *d;
+
+    if (!(d = opendir(EDAC_SYSFS))) {
+        return 0;
+    }
+    while ((entry = readdir(d))) {
+        if (strncmp(entry->d_name, "mc", 2) || !entry->d_name[2]) {
+            continue;
+        }
+        if (!format(path, sizeof(path), "%s/%s/ce_count", EDAC_SYSFS,
+                    entry->d_name) && !add_counter(path, entry->d_name, 0)) {
+            mcs++;
+            add_dimms(entry->d_name);
+        }
+    }
+    closedir(d);
+    return mcs;
+}
+
+void edac_begin_test(void) {
+    unsigned int i;
+
+    for (i = 0; i < n_counters; i++) {
+        read_count(counters[i].path, &counters[i].before);
+    }
+}
+
+/* Print the corrected errors counted since edac_begin_test(), in all and
+   by DIMM; returns how many there were. */
+unsigned long long edac_end_test(void) {
+    unsigned long long count, total = 0, delta;
+    unsigned int i, shown = 0;
+
+    for (i = 0; i < n_counters; i++) {
+        if (!counters[i].dimm &&
+            !read_count(counters[i].path, &count) &&
+            count > counters[i].before) {
+            total += count - counters[i].before;
+        }
+    }
+    if (!total) {
+        return 0;
+    }
+    printf("    corrected ECC errors: %llu", total);
+    for (i = 0; i < n_counters; i++) {
+        if (counters[i].dimm && !read_count(counters[i].path, &count) &&
+            count > counters[i].before) {
+            delta = count - counters[i].before;
+            printf("%s%s: %llu", shown++ ? ", " : " (", counters[i].label,
+                   delta);
+        }
+    }
+    printf("%s\n", shown ? ")" : "");
+    return total;
+}
@@ -0,0 +1,28 @@
+/*
+ * Very simple but very effective user-space memory tester.
+ * Originally by Simon Kirby <sim@stormix.com> <sim@neato.org>
+ * Version 2 by Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Version 3 not publicly released.
+ * Version 4 rewrite:
+ * Copyright (C) 2004-2020 Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains the declarations for the corrected error counters
+ * of EDAC (--ecc).
+ *
+ */
+
+#ifndef _EDAC_H_
+#define _EDAC_H_
+
+#ifndef EDAC_SYSFS
+  #define EDAC_SYSFS "/sys/devices/system/edac/mc"
+#endif
+#define EDAC_COUNTERS 256       /* memory controllers and DIMMs watched */
+
+unsigned int edac_init(void);
+void edac_begin_test(void);
+unsigned long long edac_end_test(void);
+
+#endif /* _EDAC_H_ */
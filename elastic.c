@@ -0,0 +1,146 @@
+/*
+ * Very simple but very effective user-space memory tester.
+ * Originally by Simon Kirby <sim@stormix.com> <sim@neato.org>
+ * Version 2 by Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Version 3 not publicly released.
+ * Version 4 rewrite:
+ * Copyright (C) 2004-2020 Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains elastic mode (--elastic), for hosts whose free memory
+ * comes and goes.  Address space for all of <mem> is reserved up front,
+ * and only the part of it the host can spare is mapped and tested: what
+ * MemAvailable has beyond ELASTIC_HEADROOM percent of MemTotal.  Between
+ * tests, main() asks for the size memtester should have now; when memory
+ * has freed up, more is mapped in steps of ELASTIC_STEP, and when it has
+ * become short, or the kernel reports memory pressure (PSI), steps are
+ * given back with MADV_DONTNEED, so that neighbours are not OOM-killed.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "elastic.h"
+
+#ifndef MAP_NORESERVE
+  #define MAP_NORESERVE 0
+#endif
+
+/* Reserve address space for max bytes, none of it mapped yet.  Returns 0, or
+   -1 with errno set. */
+int elastic_reserve(struct elastic *e, size_t max, size_t pagesize,
+                    int lock) {
+    void *p;
+
+    max &= ~(pagesize - 1);
+    p = mmap(NULL, max, PROT_NONE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) {
+        return -1;
+    }
+    e->base = (char *) p;
+    e->max = max;
+    e->bytes = 0;
+    e->pagesize = pagesize;
+    e->lock = lock;
+    return 0;
+}
+
+/* The "some avg10" figure of /proc/pressure/memory, or -1 without PSI. */
+static double memory_pressure(void) {
+    FILE *file = fopen("/proc/pressure/memory", "r");
+    double avg10 = -1;
+
+    if (file) {
+        if (fscanf(file, "some avg10=%lf", &avg10) != 1) {
+            avg10 = -1;
+        }
+        fclose(file);
+    }
+    return avg10;
+}
+
+/* The size to test now, in ELASTIC_STEP steps up to e->max: what is mapped,
+   plus what MemAvailable has beyond the headroom (or less what it lacks),
+   and a step less than what is mapped under memory pressure.  Returns
+   e->bytes if /proc/meminfo can't be read. */
+size_t elastic_target(const struct elastic *e) {
+    FILE *file = fopen("/proc/meminfo", "r");
+    unsigned long long total = 0, avail = 0, headroom, target;
+    unsigned long long step = ELASTIC_STEP, least;
+    int have_avail = 0;
+    char line[128];
+    unsigned long kb;
+
+    if (!file) {
+        return e->bytes;
+    }
+    while (fgets(line, sizeof(line), file)) {
+        if (sscanf(line, "MemTotal: %lu kB", &kb) == 1) {
+            total = (unsigned long long) kb << 10;
+        } else if (sscanf(line, "MemAvailable: %lu kB", &kb) == 1) {
+            avail = (unsigned long long) kb << 10;
+            have_avail = 1;
+        }
+    }
+    fclose(file);
+    if (!have_avail || !total) {
+        return e->bytes;
+    }
+    headroom = total * ELASTIC_HEADROOM / 100;
+    target = e->bytes + avail;
+    target = target > headroom ? target - headroom : 0;
+    if (memory_pressure() >= ELASTIC_PSI && target >= e->bytes) {
+        target = e->bytes > step ? e->bytes - step : 0;
+    }
+    target -= target % step;
+    least = e->max < step ? e->max : step;
+    if (target < least) {
+        target = least;
+    }
+    return target > e->max ? e->max : (size_t) target;
+}
+
+/* Map (and lock) or give back memory at the end of what is mapped, so that
+   bytes are mapped.  Returns 0, or -1 with errno set and nothing changed if
+   more could not be had. */
+int elastic_resize(struct elastic *e, size_t bytes) {
+    char *start;
+    size_t len;
+    int saved;
+
+    if (bytes > e->bytes) {
+        start = e->base + e->bytes;
+        len = bytes - e->bytes;
+        if (mmap(start, len, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) ==
+            MAP_FAILED) {
+            return -1;
+        }
+        if (e->lock && mlock(start, len) < 0) {
+            saved = errno;
+            mmap(start, len, PROT_NONE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE,
+                 -1, 0);
+            errno = saved;
+            return -1;
+        }
+    } else if (bytes < e->bytes) {
+        start = e->base + bytes;
+        len = e->bytes - bytes;
+        if (e->lock) {
+            munlock(start, len);
+        }
+        madvise(start, len, MADV_DONTNEED);
+        mprotect(start, len, PROT_NONE);
+    }
+    e->bytes = bytes;
+    return 0;
+}
@@ -0,0 +1,36 @@
+/*
+ * Very simple but very effective user-space memory tester.
+ * Originally by Simon Kirby <sim@stormix.com> <sim@neato.org>
+ * Version 2 by Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Version 3 not publicly released.
+ * Version 4 rewrite:
+ * Copyright (C) 2004-2020 Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains the declarations for elastic mode.
+ *
+ */
+
+#ifndef _ELASTIC_H_
+#define _ELASTIC_H_
+
+#include <stddef.h>
+
+#define ELASTIC_STEP (256UL << 20)  /* bytes mapped or given back at a time */
+#define ELASTIC_HEADROOM 10         /* percent of MemTotal left available */
+#define ELASTIC_PSI 10.0            /* "some" avg10 memory pressure to shrink at */
+
+struct elastic {
+    char *base;                     /* start of the address space reserved */
+    size_t max;                     /* bytes reserved, the most tested */
+    size_t bytes;                   /* bytes mapped, and tested, now */
+    size_t pagesize;
+    int lock;                       /* mlock what is mapped */
+};
+
+int elastic_reserve(struct elastic *e, size_t max, size_t pagesize, int lock);
+size_t elastic_target(const struct elastic *e);
+int elastic_resize(struct elastic *e, size_t bytes);
+
+#endif /* _ELASTIC_H_ */
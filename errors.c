@@ -0,0 +1,244 @@
+/*
+ * Very simple but very effective user-space memory tester.
+ * Originally by Simon Kirby <sim@stormix.com> <sim@neato.org>
+ * Version 2 by Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Version 3 not publicly released.
+ * Version 4 rewrite:
+ * Copyright (C) 2004-2020 Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains the failure bookkeeping.  Every failure found by a test
+ * is counted per bit position and per page and kept in a fixed-size ring of
+ * the most recent ones, but only the first error_print_limit of each test are
+ * printed as they happen, so a badly broken module cannot flood the logs or
+ * stall testing.  errors_end_test() prints a summary of what was found, and
+ * errors_worst_pages() then tells which pages to look at again.  The bits
+ * and worst pages of the whole run are kept too, for errors_totals().
+ *
+ */
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "types.h"
+#include "sizes.h"
+#include "errors.h"
+#include "threads.h"
+
+#define WORST_PAGES 8           /* pages listed in the summary */
+#define LAST_FAILURES 4         /* ring entries listed in the summary */
+
+struct page_count {
+    size_t page;                /* page index + 1, 0 for a free slot */
+    unsigned long long count;
+};
+
+unsigned long error_print_limit = 100;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t pagesize = 4096;
+static const char *cur_test;
+static unsigned long cur_loop;
+static unsigned long long total;
+static unsigned long long bits[UL_LEN];
+static struct page_count pages[ERROR_PAGES];
+static size_t n_pages;
+static size_t n_sorted;         /* pages[] sorted by errors_end_test() */
+static unsigned long long other_pages;   /* failures in pages not counted */
+static struct failure ring[ERROR_RING];
+static unsigned long long run_total;
+static unsigned long long run_bits[UL_LEN];
+static struct page_count run_pages[ERROR_RUN_PAGES];
+
+void errors_init(size_t size) {
+    pagesize = size;
+}
+
+void errors_begin_test(const char *test, unsigned long loop) {
+    pthread_mutex_lock(&lock);
+    cur_test = test;
+    cur_loop = loop;
+    total = 0;
+    memset(bits, 0, sizeof(bits));
+    memset(pages, 0, sizeof(pages));
+    n_pages = 0;
+    n_sorted = 0;
+    other_pages = 0;
+    pthread_mutex_unlock(&lock);
+}
+
+static void count_page(size_t page) {
+    size_t h = (page * 2654435761UL) % ERROR_PAGES;
+    size_t n;
+
+    for (n = 0; n < ERROR_PAGES; n++, h = (h + 1) % ERROR_PAGES) {
+        if (pages[h].page == page + 1) {
+            pages[h].count++;
+            return;
+        }
+        if (!pages[h].page) {
+            /* Leave some room so lookups stay short. */
+            if (n_pages >= ERROR_PAGES / 2) {
+                break;
+            }
+            pages[h].page = page + 1;
+            pages[h].count = 1;
+            n_pages++;
+            return;
+        }
+    }
+    other_pages++;
+}
+
+/* Record a failure; returns non-zero if the caller should print it. */
+int error_record(size_t offset, ul actual, ul expected) {
+    struct failure *f;
+    ul mask = actual ^ expected;
+    unsigned int b;
+    int print;
+
+    if (cur_worker) {
+        cur_worker->errors++;
+    }
+    pthread_mutex_lock(&lock);
+    f = &ring[total % ERROR_RING];
+    f->offset = offset;
+    f->actual = actual;
+    f->expected = expected;
+    f->test = cur_test;
+    f->loop = cur_loop;
+    f->node = cur_worker ? cur_worker->slice->node : -1;
+    for (b = 0; b < UL_LEN; b++) {
+        if (mask & (1UL << b)) {
+            bits[b]++;
+            run_bits[b]++;
+        }
+    }
+    run_total++;
+    count_page(offset / pagesize);
+    print = total < error_print_limit;
+    total++;
+    pthread_mutex_unlock(&lock);
+    return print;
+}
+
+static int by_count(const void *a, const void *b) {
+    const struct page_count *pa = a, *pb = b;
+
+    if (pa->count != pb->count) {
+        return pa->count < pb->count ? 1 : -1;
+    }
+    return pa->page < pb->page ? -1 : pa->page > pb->page;
+}
+
+/* Count the sorted pages of the test just run into the worst pages of the
+   run, keeping the ERROR_RUN_PAGES with the most failures. */
+static void count_run_pages(size_t shown) {
+    size_t i, j, least;
+
+    for (i = 0; i < shown; i++) {
+        least = 0;
+        for (j = 0; j < ERROR_RUN_PAGES; j++) {
+            if (run_pages[j].page == pages[i].page || !run_pages[j].page) {
+                break;
+            }
+            if (run_pages[j].count < run_pages[least].count) {
+                least = j;
+            }
+        }
+        if (j < ERROR_RUN_PAGES) {
+            run_pages[j].page = pages[i].page;
+            run_pages[j].count += pages[i].count;
+        } else if (run_pages[least].count < pages[i].count) {
+            run_pages[least] = pages[i];
+        }
+    }
+    qsort(run_pages, ERROR_RUN_PAGES, sizeof(run_pages[0]), by_count);
+}
+
+/* Print the summary of the test just run; returns its number of failures. */
+unsigned long long errors_end_test(void) {
+    unsigned long long n;
+    struct failure *f;
+    unsigned int b, i;
+    size_t j, shown;
+
+    pthread_mutex_lock(&lock);
+    n = total;
+    if (!n) {
+        pthread_mutex_unlock(&lock);
+        return 0;
+    }
+    fprintf(stderr, "  %s: %llu failures", cur_test, n);
+    if (n > error_print_limit) {
+        fprintf(stderr, ", %llu more suppressed", n - error_print_limit);
+    }
+    fprintf(stderr, "\n    failing bits:");
+    for (b = 0; b < UL_LEN; b++) {
+        if (bits[b]) {
+            fprintf(stderr, " %u (%llu)", b, bits[b]);
+        }
+    }
+    /* Compact the page table to sort it; it is cleared for the next test. */
+    for (j = 0, shown = 0; j < ERROR_PAGES; j++) {
+        if (pages[j].page) {
+            pages[shown++] = pages[j];
+        }
+    }
+    qsort(pages, shown, sizeof(pages[0]), by_count);
+    n_sorted = shown;
+    count_run_pages(shown);
+    fprintf(stderr, "\n    failing pages: %lu%s, worst:", (ul) shown,
+            other_pages ? "+" : "");
+    for (j = 0; j < shown && j < WORST_PAGES; j++) {
+        fprintf(stderr, " 0x%08lx (%llu)",
+                (ul) ((pages[j].page - 1) * pagesize), pages[j].count);
+    }
+    fprintf(stderr, "\n");
+    if (n > error_print_limit) {
+        fprintf(stderr, "    last failures:\n");
+        for (i = LAST_FAILURES; i > 0; i--) {
+            if (i > n - error_print_limit || i > ERROR_RING) {
+                continue;
+            }
+            f = &ring[(n - i) % ERROR_RING];
+            fprintf(stderr, "      0x%08lx != 0x%08lx (xor 0x%08lx) at "
+                    "offset 0x%08lx\n", f->actual, f->expected,
+                    f->actual ^ f->expected, (ul) f->offset);
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return n;
+}
+
+/* The byte offsets of the pages the last test failed in, the most failures
+   first, until the next errors_begin_test(); returns how many there are, at
+   most max. */
+size_t errors_worst_pages(size_t *offsets, size_t max) {
+    size_t i;
+
+    pthread_mutex_lock(&lock);
+    for (i = 0; i < n_sorted && i < max; i++) {
+        offsets[i] = (pages[i].page - 1) * pagesize;
+    }
+    pthread_mutex_unlock(&lock);
+    return i;
+}
+
+void errors_totals(struct error_totals *t) {
+    size_t i;
+
+    pthread_mutex_lock(&lock);
+    t->total = run_total;
+    memcpy(t->bits, run_bits, sizeof(t->bits));
+    for (i = 0; i < ERROR_RUN_PAGES && run_pages[i].page; i++) {
+        t->page[i] = (run_pages[i].page - 1) * pagesize;
+        t->page_count[i] = run_pages[i].count;
+    }
+    t->n_pages = i;
+    pthread_mutex_unlock(&lock);
+}
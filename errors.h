@@ -0,0 +1,53 @@
+/*
+ * Very simple but very effective user-space memory tester.
+ * Originally by Simon Kirby <sim@stormix.com> <sim@neato.org>
+ * Version 2 by Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Version 3 not publicly released.
+ * Version 4 rewrite:
+ * Copyright (C) 2004-2020 Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains the declarations for the failure bookkeeping.
+ *
+ */
+
+#ifndef _ERRORS_H_
+#define _ERRORS_H_
+
+#include <stddef.h>
+
+#define ERROR_RING 1024         /* most recent failures kept per test */
+#define ERROR_PAGES 4096        /* distinct failing pages counted per test */
+#define ERROR_RUN_PAGES 16      /* worst pages of the whole run kept */
+#define ERROR_BITS (8 * sizeof(unsigned long))
+
+struct failure {
+    size_t offset;              /* byte offset in the tested region */
+    unsigned long actual;
+    unsigned long expected;     /* in mirror mode, the other half's word */
+    const char *test;
+    unsigned long loop;
+    int node;
+};
+
+/* The failures of the whole run so far, for --metrics.  Pages are only
+   counted in as each test ends. */
+struct error_totals {
+    unsigned long long total;
+    unsigned long long bits[ERROR_BITS];
+    size_t n_pages;
+    size_t page[ERROR_RUN_PAGES];           /* byte offset, most failures */
+    unsigned long long page_count[ERROR_RUN_PAGES];         /* first */
+};
+
+extern unsigned long error_print_limit;
+
+void errors_init(size_t pagesize);
+void errors_begin_test(const char *test, unsigned long loop);
+int error_record(size_t offset, unsigned long actual, unsigned long expected);
+unsigned long long errors_end_test(void);
+size_t errors_worst_pages(size_t *offsets, size_t max);
+void errors_totals(struct error_totals *t);
+
+#endif /* _ERRORS_H_ */
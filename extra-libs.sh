@@ -3,7 +3,7 @@
 case "$1" in
 osf1-*) 
   # OSF/1 (Tru64) needs /usr/lib/librt.a for mlock()
-  echo /usr/lib/librt.a
+  echo /usr/lib/librt.a -lpthread
   ;;
 unix_sv*) ;;
 irix64-*) ;;
@@ -12,5 +12,6 @@ dgux-*) ;;
 hp-ux-*) ;;
 sco*) ;;
 *)
+  echo -lpthread
   ;;
 esac
@@ -0,0 +1,857 @@
+/*
+ * Very simple but very effective user-space memory tester.
+ * Originally by Simon Kirby <sim@stormix.com> <sim@neato.org>
+ * Version 2 by Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Version 3 not publicly released.
+ * Version 4 rewrite:
+ * Copyright (C) 2004-2020 Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains the fill and compare kernels used by the pattern tests
+ * and compare_regions().  The scalar kernels access memory one volatile word
+ * at a time and are the reference.  Where the compiler and CPU allow it,
+ * vector kernels (SSE2, AVX2 and AVX-512 on x86-64, NEON on arm64) are built
+ * with target attributes and picked at startup, so conf-cc needs no extra
+ * flags.  The vector kernels store and load every word exactly once, and end
+ * with a compiler barrier so none of their accesses can be dropped.
+ *
+ * The narrow kernels access memory 8, 16 or 32 bits at a time instead, for
+ * --width; they split each even/odd pattern word into pieces of their width
+ * once per call, so their loops have no test in them either.
+ *
+ * With --nontemporal, the vector kernels write with streaming stores which
+ * bypass the caches, and the tested memory is flushed from the caches before
+ * it is read back, so that verification reads really come from DRAM.
+ *
+ */
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+#include "types.h"
+#include "sizes.h"
+#include "kernels.h"
+
+#if defined(__GNUC__) && (UL_LEN == 64)
+  #if defined(__x86_64__)
+    #define KERNELS_X86 1
+    #include <immintrin.h>
+    #include <cpuid.h>
+  #elif defined(__aarch64__)
+    #define KERNELS_NEON 1
+    #include <arm_neon.h>
+    #ifdef __linux__
+      #include <sys/auxv.h>
+      #include <asm/hwcap.h>
+    #endif
+  #endif
+  #define kernel_barrier() __asm__ __volatile__("" ::: "memory")
+#endif
+
+/* Whether lines can be evicted from the caches from user space, which the
+   hammer test and the first phase of the address line test need; set by
+   cache_flush_init(). */
+static int have_user_flush;
+
+/* Scalar reference kernels.  They step over the words two at a time, so
+   that even and odd words are stored and checked without a test in the
+   loop. */
+
+static void scalar_fill(ulv *bufa, ulv *bufb, size_t count, ul even, ul odd) {
+    size_t i;
+
+    for (i = 0; i + 2 <= count; i += 2) {
+        bufa[i] = bufb[i] = even;
+        bufa[i + 1] = bufb[i + 1] = odd;
+    }
+    if (i < count) {
+        bufa[i] = bufb[i] = even;
+    }
+}
+
+static size_t scalar_compare(ulv *bufa, ulv *bufb, size_t count) {
+    ulv *p1 = bufa;
+    ulv *p2 = bufb;
+    size_t i;
+
+    for (i = 0; i < count; i++, p1++, p2++) {
+        if (*p1 != *p2) {
+            break;
+        }
+    }
+    return i;
+}
+
+static void scalar_fill_one(ulv *buf, size_t count, ul even, ul odd) {
+    size_t i;
+
+    for (i = 0; i + 2 <= count; i += 2) {
+        buf[i] = even;
+        buf[i + 1] = odd;
+    }
+    if (i < count) {
+        buf[i] = even;
+    }
+}
+
+static size_t scalar_verify(ulv *buf, size_t count, ul even, ul odd) {
+    size_t i;
+
+    for (i = 0; i + 2 <= count; i += 2) {
+        if (buf[i] != even) {
+            return i;
+        }
+        if (buf[i + 1] != odd) {
+            return i + 1;
+        }
+    }
+    if (i < count && buf[i] != even) {
+        return i;
+    }
+    return count;
+}
+
+static size_t scalar_verify_fill(ulv *buf, size_t count, ul even, ul odd,
+                                 ul next_even, ul next_odd) {
+    size_t i;
+
+    for (i = 0; i + 2 <= count; i += 2) {
+        if (buf[i] != even) {
+            return i;
+        }
+        buf[i] = next_even;
+        if (buf[i + 1] != odd) {
+            return i + 1;
+        }
+        buf[i + 1] = next_odd;
+    }
+    if (i < count) {
+        if (buf[i] != even) {
+            return i;
+        }
+        buf[i] = next_even;
+    }
+    return count;
+}
+
+static ul scalar_xor_all(ulv *buf, size_t count) {
+    ul x = 0;
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        x ^= buf[i];
+    }
+    return x;
+}
+
+/*
+ * Narrow kernels.  NARROW_KERNELS() expands to a set of kernels accessing
+ * memory through pointers to type, which is narrower than a word; a pair of
+ * even and odd words is pieces[] of those.
+ */
+#define NARROW_KERNELS(name, type) \
+static void name##_setup(type *pieces, ul even, ul odd) { \
+    memcpy(pieces, &even, sizeof(ul)); \
+    memcpy((char *) pieces + sizeof(ul), &odd, sizeof(ul)); \
+} \
+\
+static void name##_fill_one(ulv *buf, size_t count, ul even, ul odd) { \
+    type volatile *p = (type volatile *) buf; \
+    type pieces[2 * sizeof(ul) / sizeof(type)]; \
+    size_t i, j, n = 2 * sizeof(ul) / sizeof(type); \
+\
+    name##_setup(pieces, even, odd); \
+    for (i = 0; i + 2 <= count; i += 2) { \
+        for (j = 0; j < n; j++) { \
+            *p++ = pieces[j]; \
+        } \
+    } \
+    for (j = 0; i < count && j < n / 2; j++) { \
+        *p++ = pieces[j]; \
+    } \
+} \
+\
+static void name##_fill(ulv *bufa, ulv *bufb, size_t count, ul even, \
+                        ul odd) { \
+    type volatile *p1 = (type volatile *) bufa; \
+    type volatile *p2 = (type volatile *) bufb; \
+    type pieces[2 * sizeof(ul) / sizeof(type)]; \
+    size_t i, j, n = 2 * sizeof(ul) / sizeof(type); \
+\
+    name##_setup(pieces, even, odd); \
+    for (i = 0; i + 2 <= count; i += 2) { \
+        for (j = 0; j < n; j++) { \
+            *p1++ = *p2++ = pieces[j]; \
+        } \
+    } \
+    for (j = 0; i < count && j < n / 2; j++) { \
+        *p1++ = *p2++ = pieces[j]; \
+    } \
+} \
+\
+static size_t name##_compare(ulv *bufa, ulv *bufb, size_t count) { \
+    type volatile *p1 = (type volatile *) bufa; \
+    type volatile *p2 = (type volatile *) bufb; \
+    size_t i, n = count * (sizeof(ul) / sizeof(type)); \
+\
+    for (i = 0; i < n; i++) { \
+        if (p1[i] != p2[i]) { \
+            break; \
+        } \
+    } \
+    return i / (sizeof(ul) / sizeof(type)); \
+} \
+\
+static size_t name##_verify(ulv *buf, size_t count, ul even, ul odd) { \
+    type volatile *p = (type volatile *) buf; \
+    type pieces[2 * sizeof(ul) / sizeof(type)]; \
+    size_t i, n = count * (sizeof(ul) / sizeof(type)); \
+    size_t m = 2 * sizeof(ul) / sizeof(type); \
+\
+    name##_setup(pieces, even, odd); \
+    for (i = 0; i < n; i++) { \
+        if (p[i] != pieces[i % m]) { \
+            break; \
+        } \
+    } \
+    return i / (sizeof(ul) / sizeof(type)); \
+} \
+\
+static size_t name##_verify_fill(ulv *buf, size_t count, ul even, ul odd, \
+                                 ul next_even, ul next_odd) { \
+    type volatile *p = (type volatile *) buf; \
+    type pieces[2 * sizeof(ul) / sizeof(type)]; \
+    type next[2 * sizeof(ul) / sizeof(type)]; \
+    size_t i, n = count * (sizeof(ul) / sizeof(type)); \
+    size_t m = 2 * sizeof(ul) / sizeof(type); \
+\
+    name##_setup(pieces, even, odd); \
+    name##_setup(next, next_even, next_odd); \
+    for (i = 0; i < n; i++) { \
+        if (p[i] != pieces[i % m]) { \
+            break; \
+        } \
+        p[i] = next[i % m]; \
+    } \
+    return i / (sizeof(ul) / sizeof(type)); \
+} \
+\
+static ul name##_xor_all(ulv *buf, size_t count) { \
+    type volatile *p = (type volatile *) buf; \
+    type pieces[sizeof(ul) / sizeof(type)]; \
+    size_t i, j, n = sizeof(ul) / sizeof(type); \
+    ul x; \
+\
+    memset(pieces, 0, sizeof(pieces)); \
+    for (i = 0; i < count; i++) { \
+        for (j = 0; j < n; j++) { \
+            pieces[j] ^= *p++; \
+        } \
+    } \
+    memcpy(&x, pieces, sizeof(ul)); \
+    return x; \
+}
+
+NARROW_KERNELS(narrow8, unsigned char)
+NARROW_KERNELS(narrow16, unsigned short)
+#if UL_LEN > 32
+NARROW_KERNELS(narrow32, unsigned int)
+#endif
+
+/*
+ * Vector kernels.  Each instruction set provides a vector type holding
+ * `words` unsigned longs and five helpers: isa_set() builds an even/odd
+ * pattern vector, isa_load()/isa_store() are unaligned accesses,
+ * isa_same() tells whether two vectors are equal and isa_xor() combines
+ * them.  VECTOR_KERNELS() then
+ * expands to the full set of kernels; whatever does not fill a whole vector
+ * is finished one word at a time.
+ */
+#define VECTOR_KERNELS(isa, attr, vec, words) \
+attr static void isa##_fill(ulv *bufa, ulv *bufb, size_t count, \
+                            ul even, ul odd) { \
+    vec v = isa##_set(even, odd); \
+    size_t i; \
+\
+    for (i = 0; i + (words) <= count; i += (words)) { \
+        isa##_store(&bufa[i], v); \
+        isa##_store(&bufb[i], v); \
+    } \
+    for (; i < count; i++) { \
+        bufa[i] = bufb[i] = (i % 2) == 0 ? even : odd; \
+    } \
+    kernel_barrier(); \
+} \
+\
+attr static size_t isa##_compare(ulv *bufa, ulv *bufb, size_t count) { \
+    size_t i; \
+\
+    for (i = 0; i + (words) <= count; i += (words)) { \
+        if (!isa##_same(isa##_load(&bufa[i]), isa##_load(&bufb[i]))) { \
+            break; \
+        } \
+    } \
+    kernel_barrier(); \
+    for (; i < count; i++) { \
+        if (bufa[i] != bufb[i]) { \
+            break; \
+        } \
+    } \
+    return i; \
+} \
+\
+attr static void isa##_fill_one(ulv *buf, size_t count, ul even, ul odd) { \
+    vec v = isa##_set(even, odd); \
+    size_t i; \
+\
+    for (i = 0; i + (words) <= count; i += (words)) { \
+        isa##_store(&buf[i], v); \
+    } \
+    for (; i < count; i++) { \
+        buf[i] = (i % 2) == 0 ? even : odd; \
+    } \
+    kernel_barrier(); \
+} \
+\
+attr static size_t isa##_verify(ulv *buf, size_t count, ul even, ul odd) { \
+    vec v = isa##_set(even, odd); \
+    size_t i; \
+\
+    for (i = 0; i + (words) <= count; i += (words)) { \
+        if (!isa##_same(isa##_load(&buf[i]), v)) { \
+            break; \
+        } \
+    } \
+    kernel_barrier(); \
+    for (; i < count; i++) { \
+        if (buf[i] != ((i % 2) == 0 ? even : odd)) { \
+            break; \
+        } \
+    } \
+    return i; \
+} \
+\
+attr static size_t isa##_verify_fill(ulv *buf, size_t count, ul even, \
+                                     ul odd, ul next_even, ul next_odd) { \
+    vec v = isa##_set(even, odd); \
+    vec next = isa##_set(next_even, next_odd); \
+    size_t i; \
+\
+    for (i = 0; i + (words) <= count; i += (words)) { \
+        if (!isa##_same(isa##_load(&buf[i]), v)) { \
+            break; \
+        } \
+        isa##_store(&buf[i], next); \
+    } \
+    for (; i < count; i++) { \
+        if (buf[i] != ((i % 2) == 0 ? even : odd)) { \
+            break; \
+        } \
+        buf[i] = (i % 2) == 0 ? next_even : next_odd; \
+    } \
+    kernel_barrier(); \
+    return i; \
+} \
+\
+attr static ul isa##_xor_all(ulv *buf, size_t count) { \
+    vec v = isa##_set(0, 0); \
+    ul lanes[words], x = 0; \
+    size_t i; \
+\
+    for (i = 0; i + (words) <= count; i += (words)) { \
+        v = isa##_xor(v, isa##_load(&buf[i])); \
+    } \
+    kernel_barrier(); \
+    for (; i < count; i++) { \
+        x ^= buf[i]; \
+    } \
+    isa##_store(lanes, v); \
+    for (i = 0; i < (words); i++) { \
+        x ^= lanes[i]; \
+    } \
+    return x; \
+}
+
+/*
+ * Streaming-store variants, for instruction sets which also provide
+ * isa_stream() (an aligned non-temporal store of one vector) and isa_fence()
+ * (which orders streaming stores before later accesses).  Words before the
+ * first vector-aligned one are stored normally.
+ */
+#define NT_KERNELS(isa, attr, vec, words) \
+attr static void isa##_nt_fill_one(ulv *buf, size_t count, ul even, ul odd) { \
+    vec v; \
+    size_t i = 0; \
+\
+    for (; i < count && (size_t) &buf[i] % sizeof(vec); i++) { \
+        buf[i] = (i % 2) == 0 ? even : odd; \
+    } \
+    v = (i % 2) == 0 ? isa##_set(even, odd) : isa##_set(odd, even); \
+    for (; i + (words) <= count; i += (words)) { \
+        isa##_stream(&buf[i], v); \
+    } \
+    for (; i < count; i++) { \
+        buf[i] = (i % 2) == 0 ? even : odd; \
+    } \
+    isa##_fence(); \
+    kernel_barrier(); \
+} \
+\
+attr static void isa##_nt_fill(ulv *bufa, ulv *bufb, size_t count, \
+                               ul even, ul odd) { \
+    isa##_nt_fill_one(bufa, count, even, odd); \
+    isa##_nt_fill_one(bufb, count, even, odd); \
+} \
+\
+attr static size_t isa##_nt_verify_fill(ulv *buf, size_t count, ul even, \
+                                        ul odd, ul next_even, ul next_odd) { \
+    vec v, next; \
+    size_t i = 0; \
+\
+    for (; i < count && (size_t) &buf[i] % sizeof(vec); i++) { \
+        if (buf[i] != ((i % 2) == 0 ? even : odd)) { \
+            return i; \
+        } \
+        buf[i] = (i % 2) == 0 ? next_even : next_odd; \
+    } \
+    v = (i % 2) == 0 ? isa##_set(even, odd) : isa##_set(odd, even); \
+    next = (i % 2) == 0 ? isa##_set(next_even, next_odd) \
+                        : isa##_set(next_odd, next_even); \
+    for (; i + (words) <= count; i += (words)) { \
+        if (!isa##_same(isa##_load(&buf[i]), v)) { \
+            break; \
+        } \
+        isa##_stream(&buf[i], next); \
+    } \
+    for (; i < count; i++) { \
+        if (buf[i] != ((i % 2) == 0 ? even : odd)) { \
+            break; \
+        } \
+        buf[i] = (i % 2) == 0 ? next_even : next_odd; \
+    } \
+    isa##_fence(); \
+    kernel_barrier(); \
+    return i; \
+}
+
+#ifdef KERNELS_X86
+#define SSE2 __attribute__((target("sse2")))
+#define AVX2 __attribute__((target("avx2")))
+#define AVX512 __attribute__((target("avx512f")))
+
+SSE2 static inline __m128i sse2_set(ul even, ul odd) {
+    return _mm_set_epi64x((long long) odd, (long long) even);
+}
+
+SSE2 static inline __m128i sse2_load(ulv *p) {
+    return _mm_loadu_si128((__m128i *) p);
+}
+
+SSE2 static inline void sse2_store(ulv *p, __m128i v) {
+    _mm_storeu_si128((__m128i *) p, v);
+}
+
+SSE2 static inline int sse2_same(__m128i a, __m128i b) {
+    return _mm_movemask_epi8(_mm_cmpeq_epi32(a, b)) == 0xffff;
+}
+
+SSE2 static inline __m128i sse2_xor(__m128i a, __m128i b) {
+    return _mm_xor_si128(a, b);
+}
+
+SSE2 static inline void sse2_stream(ulv *p, __m128i v) {
+    _mm_stream_si128((__m128i *) p, v);
+}
+
+SSE2 static inline void sse2_fence(void) {
+    _mm_sfence();
+}
+
+AVX2 static inline __m256i avx2_set(ul even, ul odd) {
+    return _mm256_set_epi64x((long long) odd, (long long) even,
+                             (long long) odd, (long long) even);
+}
+
+AVX2 static inline __m256i avx2_load(ulv *p) {
+    return _mm256_loadu_si256((__m256i *) p);
+}
+
+AVX2 static inline void avx2_store(ulv *p, __m256i v) {
+    _mm256_storeu_si256((__m256i *) p, v);
+}
+
+AVX2 static inline int avx2_same(__m256i a, __m256i b) {
+    return _mm256_movemask_epi8(_mm256_cmpeq_epi64(a, b)) == -1;
+}
+
+AVX2 static inline __m256i avx2_xor(__m256i a, __m256i b) {
+    return _mm256_xor_si256(a, b);
+}
+
+AVX2 static inline void avx2_stream(ulv *p, __m256i v) {
+    _mm256_stream_si256((__m256i *) p, v);
+}
+
+AVX2 static inline void avx2_fence(void) {
+    _mm_sfence();
+}
+
+AVX512 static inline __m512i avx512_set(ul even, ul odd) {
+    return _mm512_set_epi64((long long) odd, (long long) even,
+                            (long long) odd, (long long) even,
+                            (long long) odd, (long long) even,
+                            (long long) odd, (long long) even);
+}
+
+AVX512 static inline __m512i avx512_load(ulv *p) {
+    return _mm512_loadu_si512((void *) p);
+}
+
+AVX512 static inline void avx512_store(ulv *p, __m512i v) {
+    _mm512_storeu_si512((void *) p, v);
+}
+
+AVX512 static inline int avx512_same(__m512i a, __m512i b) {
+    return _mm512_cmpneq_epi64_mask(a, b) == 0;
+}
+
+AVX512 static inline __m512i avx512_xor(__m512i a, __m512i b) {
+    return _mm512_xor_si512(a, b);
+}
+
+AVX512 static inline void avx512_stream(ulv *p, __m512i v) {
+    _mm512_stream_si512((void *) p, v);
+}
+
+AVX512 static inline void avx512_fence(void) {
+    _mm_sfence();
+}
+
+VECTOR_KERNELS(sse2, SSE2, __m128i, 2)
+VECTOR_KERNELS(avx2, AVX2, __m256i, 4)
+VECTOR_KERNELS(avx512, AVX512, __m512i, 8)
+NT_KERNELS(sse2, SSE2, __m128i, 2)
+NT_KERNELS(avx2, AVX2, __m256i, 4)
+NT_KERNELS(avx512, AVX512, __m512i, 8)
+
+#define CACHE_LINE 64
+#define CPUID_CLFSH (1 << 19)   /* CLFLUSH, in EDX of leaf 1 */
+
+static int have_clflushopt;
+
+__attribute__((target("clflushopt")))
+static void clflushopt_lines(ulv *buf, size_t bytes) {
+    char *p = (char *) ((size_t) buf & ~((size_t) CACHE_LINE - 1));
+    char *end = (char *) buf + bytes;
+
+    for (; p < end; p += CACHE_LINE) {
+        _mm_clflushopt(p);
+    }
+}
+
+/* Write back and evict buf from every cache level. */
+static void cache_flush(ulv *buf, size_t count) {
+    char *p = (char *) ((size_t) buf & ~((size_t) CACHE_LINE - 1));
+    char *end = (char *) (buf + count);
+
+    _mm_mfence();
+    if (have_clflushopt) {
+        clflushopt_lines(buf, count * sizeof(ul));
+    } else {
+        for (; p < end; p += CACHE_LINE) {
+            _mm_clflush(p);
+        }
+    }
+    _mm_mfence();
+}
+
+static void cache_flush_init(void) {
+    unsigned int eax, ebx, ecx, edx;
+
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        have_user_flush = (edx & CPUID_CLFSH) != 0;
+    }
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        have_clflushopt = (ebx & bit_CLFLUSHOPT) != 0;
+    }
+}
+#endif /* KERNELS_X86 */
+
+#ifdef KERNELS_NEON
+static inline uint64x2_t neon_set(ul even, ul odd) {
+    return vcombine_u64(vcreate_u64(even), vcreate_u64(odd));
+}
+
+static inline uint64x2_t neon_load(ulv *p) {
+    return vld1q_u64((uint64_t *) p);
+}
+
+static inline void neon_store(ulv *p, uint64x2_t v) {
+    vst1q_u64((uint64_t *) p, v);
+}
+
+static inline int neon_same(uint64x2_t a, uint64x2_t b) {
+    uint64x2_t x = veorq_u64(a, b);
+
+    return (vgetq_lane_u64(x, 0) | vgetq_lane_u64(x, 1)) == 0;
+}
+
+static inline uint64x2_t neon_xor(uint64x2_t a, uint64x2_t b) {
+    return veorq_u64(a, b);
+}
+
+/* STNP of the two lanes; arm64 has no streaming store intrinsic. */
+static inline void neon_stream(ulv *p, uint64x2_t v) {
+    __asm__ __volatile__("stnp %x1, %x2, [%0]"
+                         : : "r" (p), "r" (vgetq_lane_u64(v, 0)),
+                             "r" (vgetq_lane_u64(v, 1))
+                         : "memory");
+}
+
+static inline void neon_fence(void) {
+    __asm__ __volatile__("dmb ishst" : : : "memory");
+}
+
+VECTOR_KERNELS(neon, , uint64x2_t, 2)
+NT_KERNELS(neon, , uint64x2_t, 2)
+
+static size_t cache_line;
+
+/* Clean and invalidate buf to the point of coherency (DC CIVAC). */
+static void cache_flush(ulv *buf, size_t count) {
+    char *p = (char *) ((size_t) buf & ~(cache_line - 1));
+    char *end = (char *) (buf + count);
+
+    __asm__ __volatile__("dsb ish" : : : "memory");
+    for (; p < end; p += cache_line) {
+        __asm__ __volatile__("dc civac, %0" : : "r" (p) : "memory");
+    }
+    __asm__ __volatile__("dsb ish" : : : "memory");
+}
+
+static void cache_flush_init(void) {
+    unsigned long ctr;
+
+    __asm__ __volatile__("mrs %0, ctr_el0" : "=r" (ctr));
+    cache_line = 4UL << ((ctr >> 16) & 0xf);
+    /* Linux lets user space run DC CIVAC (SCTLR_EL1.UCI). */
+    have_user_flush = 1;
+}
+#endif /* KERNELS_NEON */
+
+static void no_flush(ulv *buf, size_t count) {
+    (void) buf;
+    (void) count;
+}
+
+static int scalar_usable(void) {
+    return 1;
+}
+
+#ifdef KERNELS_X86
+static int sse2_usable(void) {
+    return __builtin_cpu_supports("sse2");
+}
+
+static int avx2_usable(void) {
+    return __builtin_cpu_supports("avx2");
+}
+
+static int avx512_usable(void) {
+    return __builtin_cpu_supports("avx512f");
+}
+#endif
+
+#ifdef KERNELS_NEON
+static int neon_usable(void) {
+#if defined(__linux__) && defined(HWCAP_ASIMD)
+    return (getauxval(AT_HWCAP) & HWCAP_ASIMD) != 0;
+#else
+    return 1;   /* Advanced SIMD is mandatory on arm64. */
+#endif
+}
+#endif
+
+#define KERNEL_SET(isa, width) \
+    { #isa, width, isa##_fill, isa##_compare, isa##_fill_one, isa##_verify, \
+      isa##_verify_fill, isa##_xor_all, no_flush }
+#define NT_SET(isa) \
+    { isa##_nt_fill, isa##_nt_fill_one, isa##_nt_verify_fill }
+#define NO_NT_SET { NULL, NULL, NULL }
+
+/* Best first; "auto" picks the first usable entry. */
+static const struct {
+    struct kernels k;
+    struct {
+        void (*fill)(ulv *bufa, ulv *bufb, size_t count, ul even, ul odd);
+        void (*fill_one)(ulv *buf, size_t count, ul even, ul odd);
+        size_t (*verify_fill)(ulv *buf, size_t count, ul even, ul odd,
+                              ul next_even, ul next_odd);
+    } nt;
+    int (*usable)(void);
+} all_kernels[] = {
+#ifdef KERNELS_X86
+    { KERNEL_SET(avx512, 512), NT_SET(avx512), avx512_usable },
+    { KERNEL_SET(avx2, 256), NT_SET(avx2), avx2_usable },
+    { KERNEL_SET(sse2, 128), NT_SET(sse2), sse2_usable },
+#endif
+#ifdef KERNELS_NEON
+    { KERNEL_SET(neon, 128), NT_SET(neon), neon_usable },
+#endif
+    { KERNEL_SET(scalar, UL_LEN), NO_NT_SET, scalar_usable },
+    /* Never picked by "auto", which stops at scalar. */
+#if UL_LEN > 32
+    { KERNEL_SET(narrow32, 32), NO_NT_SET, scalar_usable },
+#endif
+    { KERNEL_SET(narrow16, 16), NO_NT_SET, scalar_usable },
+    { KERNEL_SET(narrow8, 8), NO_NT_SET, scalar_usable },
+};
+
+#define N_KERNELS (sizeof(all_kernels) / sizeof(all_kernels[0]))
+
+static struct kernels selected = KERNEL_SET(scalar, UL_LEN);
+const struct kernels *kern = &selected;
+
+/* Make entry i the selected kernels, with streaming stores if asked. */
+static int use_kernels(size_t i, int nontemporal) {
+#if defined(KERNELS_X86) || defined(KERNELS_NEON)
+    cache_flush_init();
+#endif
+    selected = all_kernels[i].k;
+    if (!nontemporal) {
+        return 0;
+    }
+    if (!all_kernels[i].nt.fill) {
+        fprintf(stderr, "%s kernels have no non-temporal stores\n",
+                selected.name);
+        return -1;
+    }
+#if defined(KERNELS_X86) || defined(KERNELS_NEON)
+    selected.fill = all_kernels[i].nt.fill;
+    selected.fill_one = all_kernels[i].nt.fill_one;
+    selected.verify_fill = all_kernels[i].nt.verify_fill;
+    selected.flush = cache_flush;
+#endif
+    return 0;
+}
+
+/* Select kernels by name, or the fastest usable ones for "auto"/NULL.
+   Returns 0 on success, -1 if the named kernels are unknown or unusable. */
+int kernels_select(const char *name, int nontemporal) {
+    size_t i;
+    int is_auto = (name == NULL || strcmp(name, "auto") == 0);
+
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+#endif
+    for (i = 0; i < N_KERNELS; i++) {
+        if (!is_auto && strcmp(name, all_kernels[i].k.name) != 0) {
+            continue;
+        }
+        if (all_kernels[i].usable()) {
+            return use_kernels(i, nontemporal);
+        }
+        if (!is_auto) {
+            fprintf(stderr, "%s kernels are not supported by this CPU\n",
+                    name);
+            return -1;
+        }
+    }
+    if (!is_auto) {
+        fprintf(stderr, "unknown kernels %s; available:", name);
+        for (i = 0; i < N_KERNELS; i++) {
+            fprintf(stderr, " %s", all_kernels[i].k.name);
+        }
+        fprintf(stderr, "\n");
+    }
+    return is_auto ? 0 : -1;
+}
+
+/* Select the kernels which access memory width bits at a time (--width).
+   Returns 0 on success, -1 if there are none usable on this CPU. */
+int kernels_select_width(unsigned int width, int nontemporal) {
+    size_t i;
+
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+#endif
+    for (i = 0; i < N_KERNELS; i++) {
+        if (all_kernels[i].k.width == width && all_kernels[i].usable()) {
+            return use_kernels(i, nontemporal);
+        }
+    }
+    fprintf(stderr, "no kernels for %u-bit accesses on this CPU; widths:",
+            width);
+    for (i = 0; i < N_KERNELS; i++) {
+        if (all_kernels[i].usable()) {
+            fprintf(stderr, " %u", all_kernels[i].k.width);
+        }
+    }
+    fprintf(stderr, "\n");
+    return -1;
+}
+
+/* Write back and evict buf from the caches where the CPU lets user space do
+   it, whichever kernels are selected (the address line test). */
+void kernels_evict(ulv *buf, size_t count) {
+#if defined(KERNELS_X86) || defined(KERNELS_NEON)
+    cache_flush(buf, count);
+#else
+    (void) buf;
+    (void) count;
+#endif
+}
+
+/* Whether kernels_evict() evicts anything on this CPU, once kernels have
+   been selected; where it doesn't, reads after it may come from the
+   caches. */
+int kernels_can_evict(void) {
+    return have_user_flush;
+}
+
+/* Whether kernels_hammer() can run on this CPU, once kernels have been
+   selected. */
+int kernels_can_hammer(void) {
+    return have_user_flush;
+}
+
+/* Read the words at a and b toggles times over, evicting both from the
+   caches after each read so that every read goes to DRAM, and opens a row
+   if a and b are in different rows of one bank (the hammer test).  Returns
+   -1 if this CPU can't evict lines from user space. */
+int kernels_hammer(ulv *a, ulv *b, unsigned long toggles) {
+#if defined(KERNELS_X86)
+    unsigned long n;
+
+    if (!have_user_flush) {
+        return -1;
+    }
+    for (n = 0; n < toggles; n++) {
+        (void) *a;
+        (void) *b;
+        _mm_clflush((void *) a);
+        _mm_clflush((void *) b);
+        _mm_mfence();
+    }
+    return 0;
+#elif defined(KERNELS_NEON)
+    unsigned long n;
+
+    for (n = 0; n < toggles; n++) {
+        (void) *a;
+        (void) *b;
+        __asm__ __volatile__("dc civac, %0" : : "r" (a) : "memory");
+        __asm__ __volatile__("dc civac, %0" : : "r" (b) : "memory");
+        __asm__ __volatile__("dsb ish" : : : "memory");
+    }
+    return 0;
+#else
+    (void) a;
+    (void) b;
+    (void) toggles;
+    return -1;
+#endif
+}
@@ -0,0 +1,63 @@
+/*
+ * Very simple but very effective user-space memory tester.
+ * Originally by Simon Kirby <sim@stormix.com> <sim@neato.org>
+ * Version 2 by Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Version 3 not publicly released.
+ * Version 4 rewrite:
+ * Copyright (C) 2004-2020 Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains the declarations for the fill and compare kernels used
+ * by the pattern tests.
+ *
+ */
+
+#ifndef _KERNELS_H_
+#define _KERNELS_H_
+
+#include <stddef.h>
+
+struct kernels {
+    char *name;
+    unsigned int width;             /* bits per memory access */
+    /* Store even to the even-indexed words of both buffers and odd to the
+       odd-indexed ones. */
+    void (*fill)(unsigned long volatile *bufa, unsigned long volatile *bufb,
+                 size_t count, unsigned long even, unsigned long odd);
+    /* Return the index of the first word that differs, or count. */
+    size_t (*compare)(unsigned long volatile *bufa,
+                      unsigned long volatile *bufb, size_t count);
+
+    /* Single-buffer versions for --verify=expected: fill_one() stores the
+       pattern, verify() returns the index of the first word which does not
+       hold it (or count), and verify_fill() does the same while storing the
+       next pattern over every word it has checked. */
+    void (*fill_one)(unsigned long volatile *buf, size_t count,
+                     unsigned long even, unsigned long odd);
+    size_t (*verify)(unsigned long volatile *buf, size_t count,
+                     unsigned long even, unsigned long odd);
+    size_t (*verify_fill)(unsigned long volatile *buf, size_t count,
+                          unsigned long even, unsigned long odd,
+                          unsigned long next_even, unsigned long next_odd);
+
+    /* Return the XOR of every word, which reads all of them whatever they
+       hold (characterize's read bandwidth). */
+    unsigned long (*xor_all)(unsigned long volatile *buf, size_t count);
+
+    /* Evict buf from the caches before it is read back (--nontemporal);
+       does nothing otherwise. */
+    void (*flush)(unsigned long volatile *buf, size_t count);
+};
+
+extern const struct kernels *kern;
+
+int kernels_select(const char *name, int nontemporal);
+int kernels_select_width(unsigned int width, int nontemporal);
+void kernels_evict(unsigned long volatile *buf, size_t count);
+int kernels_can_evict(void);
+int kernels_can_hammer(void);
+int kernels_hammer(unsigned long volatile *a, unsigned long volatile *b,
+                   unsigned long toggles);
+
+#endif /* _KERNELS_H_ */
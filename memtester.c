@@ -14,56 +14,59 @@
 
 #define __version__ "4.5.1"
 
+#define _GNU_SOURCE
+
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <dirent.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <string.h>
 #include <errno.h>
+#include <getopt.h>
+#include <time.h>
 
 #include "types.h"
 #include "sizes.h"
+#include "memtester.h"
 #include "tests.h"
 #include "output.h"
+#include "threads.h"
+#include "rng.h"
+#include "kernels.h"
+#include "errors.h"
+#include "order.h"
+#include "soak.h"
+#include "checkpoint.h"
+#include "characterize.h"
+#include "elastic.h"
+#include "metrics.h"
+#include "edac.h"
+#include "numa.h"
+#include "coordinator.h"
 
-#define EXIT_FAIL_NONSTARTER    0x01
-#define EXIT_FAIL_ADDRESSLINES  0x02
-#define EXIT_FAIL_OTHERTEST     0x04
-
-struct test tests[] = {
-    { "Random Value", test_random_value },
-    { "Compare XOR", test_xor_comparison },
-    { "Compare SUB", test_sub_comparison },
-    { "Compare MUL", test_mul_comparison },
-    { "Compare DIV",test_div_comparison },
-    { "Compare OR", test_or_comparison },
-    { "Compare AND", test_and_comparison },
-    { "Sequential Increment", test_seqinc_comparison },
-    { "Solid Bits", test_solidbits_comparison },
-    { "Block Sequential", test_blockseq_comparison },
-    { "Checkerboard", test_checkerboard_comparison },
-    { "Bit Spread", test_bitspread_comparison },
-    { "Bit Flip", test_bitflip_comparison },
-    { "Walking Ones", test_walkbits1_comparison },
-    { "Walking Zeroes", test_walkbits0_comparison },
-#ifdef TEST_NARROW_WRITES
-    { "8-bit Writes", test_8bit_wide_random },
-    { "16-bit Writes", test_16bit_wide_random },
-#endif
-    { NULL, NULL }
-};
+/* With --adaptive, what a failing test is followed up with. */
+#define FOCUS_PAGES 16              /* worst failing pages swept again */
+#define FOCUS_NEIGHBOURS 2          /* pages either side of each */
+#define FOCUS_REPEATS 4             /* sweeps of every test over them */
 
 typedef struct memory_alloc {
     volatile void *buf;
     volatile void *aligned;
     size_t wantbytes;
-    int bufsize;
+    size_t bufsize;
     int do_mlock;
     int use_hugepages;
+    size_t hugepagesize;            /* for -H; 0 picks one automatically */
+    int use_thp;                    /* madvise(MADV_HUGEPAGE) the buffer */
+    int lock_on_fault;              /* leave the fault-in to the workers */
     size_t pagesize;
     ptrdiff_t pagesizemask;
 } memory_alloc_t;
@@ -83,17 +86,18 @@ void check_posix_system(void) {
 
 #ifdef _SC_PAGE_SIZE
 void memtester_pagesize(memory_alloc_t *alloc) {
-    size_t pagesize = sysconf(_SC_PAGE_SIZE);
+    size_t pagesize;
+    long sys_pagesize;
+
     if (alloc->use_hugepages) {
-        pagesize = 2L * 1024 * 1024;
+        pagesize = alloc->hugepagesize;
     } else {
-        pagesize = sysconf(_SC_PAGE_SIZE);
-        if (pagesize == -1) {
+        if ((sys_pagesize = sysconf(_SC_PAGE_SIZE)) == -1) {
             perror("get page size failed");
             exit(EXIT_FAIL_NONSTARTER);
         }
+        pagesize = (size_t) sys_pagesize;
     }
-    printf("pagesize is %ld\n", (long) pagesize);
     alloc->pagesize = pagesize;
     alloc->pagesizemask = (ptrdiff_t) ~(pagesize - 1);
 }
@@ -111,25 +115,499 @@ int memtester_pagesize(memory_alloc_t *alloc) {
   #define MAP_LOCKED 0
 #endif
 
+/* Older headers lack the flag bits that select a hugepage size for mmap. */
+#ifndef MAP_HUGE_SHIFT
+  #define MAP_HUGE_SHIFT 26
+#endif
+
+/* From <linux/mman.h>, for DAX mappings which stay synchronous. */
+#ifndef MAP_SHARED_VALIDATE
+  #define MAP_SHARED_VALIDATE 0x03
+#endif
+#ifndef MAP_SYNC
+  #define MAP_SYNC 0x80000
+#endif
+
+#define DAX_ALIGN (2UL << 20)       /* devdax alignment if sysfs won't say */
+
+/* From <linux/mman.h>, for mlock2(2). */
+#ifndef MLOCK_ONFAULT
+  #define MLOCK_ONFAULT 0x01
+#endif
+
+#define HUGEPAGES_SYSFS "/sys/kernel/mm/hugepages"
+
+/* Long options without a short equivalent. */
+enum {
+    OPT_SEED = 256,
+    OPT_KERNELS,
+    OPT_VERIFY,
+    OPT_NONTEMPORAL,
+    OPT_FORMAT,
+    OPT_REPORT,
+    OPT_MAX_ERRORS,
+    OPT_HUGEPAGES,
+    OPT_PREFAULT,
+    OPT_ORDER,
+    OPT_SOAK,
+    OPT_BANDWIDTH,
+    OPT_DUTY,
+    OPT_CHECKPOINT,
+    OPT_RESUME,
+    OPT_CHUNK,
+    OPT_TESTS,
+    OPT_WIDTH,
+    OPT_CHARACTERIZE,
+    OPT_ADAPTIVE,
+    OPT_ELASTIC,
+    OPT_METRICS,
+    OPT_ECC,
+    OPT_PROCESSES,
+};
+
+static struct option long_options[] = {
+    { "seed", required_argument, NULL, OPT_SEED },
+    { "kernels", required_argument, NULL, OPT_KERNELS },
+    { "verify", required_argument, NULL, OPT_VERIFY },
+    { "nontemporal", no_argument, NULL, OPT_NONTEMPORAL },
+    { "format", required_argument, NULL, OPT_FORMAT },
+    { "report", required_argument, NULL, OPT_REPORT },
+    { "max-errors", required_argument, NULL, OPT_MAX_ERRORS },
+    { "hugepages", required_argument, NULL, OPT_HUGEPAGES },
+    { "prefault", required_argument, NULL, OPT_PREFAULT },
+    { "order", required_argument, NULL, OPT_ORDER },
+    { "soak", no_argument, NULL, OPT_SOAK },
+    { "bandwidth", required_argument, NULL, OPT_BANDWIDTH },
+    { "duty", required_argument, NULL, OPT_DUTY },
+    { "checkpoint", required_argument, NULL, OPT_CHECKPOINT },
+    { "resume", no_argument, NULL, OPT_RESUME },
+    { "chunk", required_argument, NULL, OPT_CHUNK },
+    { "tests", required_argument, NULL, OPT_TESTS },
+    { "width", required_argument, NULL, OPT_WIDTH },
+    { "characterize", no_argument, NULL, OPT_CHARACTERIZE },
+    { "adaptive", no_argument, NULL, OPT_ADAPTIVE },
+    { "elastic", no_argument, NULL, OPT_ELASTIC },
+    { "metrics", required_argument, NULL, OPT_METRICS },
+    { "ecc", optional_argument, NULL, OPT_ECC },
+    { "processes", required_argument, NULL, OPT_PROCESSES },
+    { NULL, 0, NULL, 0 }
+};
+
 /* Function declarations */
 int usage(char *me);
 
 /* Global vars - so tests have access to this information */
 int use_phys = 0;
 off_t physaddrbase = 0;
+struct phys_range phys_ranges[PHYS_RANGES_MAX];
+unsigned int n_phys_ranges = 0;
+int verify_expected = 0;
 
 /* Function definitions */
 int usage(char *me) {
     fprintf(stderr, "\n"
-            "Usage: %s [-H] [-p physaddrbase [-d device] [-u]] <mem>[B|K|M|G] [loops]\n",
+            "Usage: %s [-H[2M|1G|auto|thp]] [-t threads] [-N] [--seed=n] [--kernels=name|--width=bits] [--verify=mirror|expected] [--nontemporal] [--format=text|json|csv] [--report=file] [--max-errors=n] [--prefault=lock|threads] [--order=list] [--soak] [--bandwidth=rate[K|M|G]] [--duty=percent] [--checkpoint=file [--resume]] [--chunk=size[K|M|G]] [--tests=list] [--characterize] [--adaptive] [--elastic] [--metrics=file] [--ecc[=fail]] [--processes=n|nodes|ranges] [-p physaddrbase [-d device] [-u]]... <mem>[B|K|M|G] [loops]\n",
             me);
     return EXIT_FAIL_NONSTARTER;
 }
 
-long get_free_hugepages(void) {
-	FILE *file = fopen("/sys/kernel/mm/hugepages/hugepages-2048kB/free_hugepages", "r");
+/* Jobs handed to the worker threads; each runs on the worker's own slice. */
+struct test_job {
+    struct test *test;
+    ul loop;
+    ul index;                       /* step in the --tests list */
+    ul repeat;                      /* repetition of the step */
+    ul order;                       /* index into the --order list */
+    size_t chunk;                   /* bytes of each half per chunk, or 0 */
+};
+
+/* Put the slice back to a known state for a test that reads what is there
+   before writing it. */
+int run_reset(struct worker *w, void *arg) {
+    size_t i, n;
+
+    (void) arg;
+    if (!soak_throttled) {
+        memset((void *) w->base, 255, w->bytes);
+        return 0;
+    }
+    for (i = 0; i < w->bytes; i += n) {
+        n = w->bytes - i < SOAK_CHUNK ? w->bytes - i : SOAK_CHUNK;
+        soak_throttle(n);
+        memset((void *) ((size_t) w->base + i), 255, n);
+    }
+    return 0;
+}
+
+/* Run the job's test on the work item's chunk of a slice, which need not be
+   w's own: words [first, first + n) of each half, or twice that of the
+   whole slice for tests that need no mirror. */
+int run_test(struct worker *w, void *arg) {
+    struct test_job *job = (struct test_job *) arg;
+    struct worker *s = w->slice;
+    size_t words = job->chunk ? job->chunk / sizeof(ul) : s->count;
+    size_t first = w->chunk * words;
+    size_t count = s->count;
+    int single = (job->test->flags & (TEST_ADDRESS | TEST_SINGLE)) ||
+        (verify_expected && (job->test->flags & TEST_PATTERN));
+    ull stream;
+
+    if (single) {
+        /* No mirror needed; test the whole slice as one buffer. */
+        words *= 2;
+        first *= 2;
+        count = s->bytes / sizeof(ul);
+    }
+    if (first >= count) {
+        return 0;
+    }
+    if (words > count - first) {
+        words = count - first;
+    }
+    /* Every (loop, test, repetition, order, chunk, passes, slice) gets its
+       own reproducible random stream, whichever worker runs it. */
+    stream = rng_key(job->loop, w->chunk);
+    stream = rng_key(stream, w->pass_first);
+    stream = rng_key(stream, job->repeat);
+    stream = rng_key(stream, job->order);
+    stream = rng_key(stream, job->index);
+    rng_init(rng_key(stream, s->id));
+    if (single) {
+        return test_run(job->test, s->base + first, NULL, words);
+    }
+    return test_run(job->test, s->bufa + first, s->bufb + first, words);
+}
+
+/* With --ecc, the corrected errors counted by EDAC during each test are
+   reported, and with --ecc=fail, they fail the run. */
+enum { ECC_OFF, ECC_REPORT, ECC_FAIL };
+static int ecc = ECC_OFF;
+
+/* Print the throughput of the test just run after its "ok", or the summary
+   of its failures (and for the hammer test, the rate of row activations),
+   then that of each -p range if there are several and the corrected errors
+   counted meanwhile, and write its result records: one for all workers
+   and, if there are several, one each.  Returns the corrected errors. */
+ull report_result(ul loop, const struct test *test, const char *order_name,
+                   int failed, double seconds) {
+    struct test_result r;
+    struct worker *w;
+    unsigned int i, k, n = workers_count();
+    ull bytes, corrected;
+    double part_seconds;
+
+    r.loop = loop;
+    r.test = test->name;
+    r.order = order_name;
+    r.thread = -1;
+    r.node = -1;
+    r.failed = failed;
+    r.errors = errors_end_test();
+    r.bytes_read = r.bytes_written = r.activations = 0;
+    r.latency_ns = 0;
+    r.seconds = seconds;
+    for (i = 0; i < n; i++) {
+        w = workers_get(i);
+        r.bytes_read += w->bytes_read;
+        r.bytes_written += w->bytes_written;
+        r.activations += w->activations;
+    }
+    soak_status.tests_run++;
+    soak_status.tests_failed += failed != 0;
+    soak_status.errors += r.errors;
+    soak_status.bytes += r.bytes_read + r.bytes_written;
+    if (!failed) {
+        printf("ok (%.2f s, %.2f GB/s", seconds, seconds > 0 ?
+               (double) (r.bytes_read + r.bytes_written) / seconds / 1e9 : 0);
+        if (test->flags & TEST_HAMMER) {
+            printf(", %.2fM activations/s", seconds > 0 ?
+                   (double) r.activations / seconds / 1e6 : 0);
+        }
+        printf(")\n");
+    }
+    /* Each range has workers of its own, which run at the same time. */
+    for (k = 0; n_phys_ranges > 1 && k < n_phys_ranges; k++) {
+        bytes = 0;
+        part_seconds = 0;
+        for (i = 0; i < n; i++) {
+            w = workers_get(i);
+            if (w->part == k) {
+                bytes += w->bytes_read + w->bytes_written;
+                if (w->seconds > part_seconds) {
+                    part_seconds = w->seconds;
+                }
+            }
+        }
+        printf("    range %u: %.2f GB/s (0x%llx of %s)\n", k,
+               part_seconds > 0 ? (double) bytes / part_seconds / 1e9 : 0,
+               (ull) phys_ranges[k].base, phys_ranges[k].device);
+    }
+    r.corrected = corrected = ecc ? edac_end_test() : 0;
+    out_report(&r);
+    metrics_result(&r);
+    for (i = 0; n > 1 && i < n; i++) {
+        w = workers_get(i);
+        r.thread = (int) w->id;
+        r.node = w->node;
+        r.failed = w->result != 0;
+        r.errors = w->errors;
+        r.bytes_read = w->bytes_read;
+        r.bytes_written = w->bytes_written;
+        r.activations = w->activations;
+        r.corrected = 0;
+        r.seconds = w->seconds;
+        out_report(&r);
+    }
+    return corrected;
+}
+
+/* Where the run has got to, saved after every chunk with --checkpoint. */
+static const char *checkpoint_path = NULL;
+static struct checkpoint progress;
+static ul nchunks = 1;
+static struct checkpoint resume_at;
+static int resuming = 0;
+
+/* The chunk a test starts from: 0, or when resuming, the one after the last
+   chunk done of the test in the checkpoint, and nchunks (nothing to do) for
+   the tests before it. */
+ul resume_from(struct test_job *job) {
+    if (!resuming) {
+        return 0;
+    }
+    if (job->index != resume_at.test) {
+        return job->index < resume_at.test ? nchunks : 0;
+    }
+    if (job->repeat != resume_at.repeat) {
+        return job->repeat < resume_at.repeat ? nchunks : 0;
+    }
+    if (job->order != resume_at.order) {
+        return job->order < resume_at.order ? nchunks : 0;
+    }
+    resuming = 0;
+    return resume_at.next_chunk;
+}
+
+/* The windows of the buffer swept by a follow-up, none across slices. */
+struct focus_job {
+    ul loop;
+    size_t offset[FOCUS_PAGES];     /* byte offset in the buffer */
+    size_t bytes[FOCUS_PAGES];
+    unsigned int n;
+};
+
+static int adaptive = 0;
+static struct test follow_up = { .name = "Follow-up", .id = "followup" };
+
+/* Run test t on the words at base, as run_test() does on a chunk, on w one
+   pass at a time, so that a failing pass doesn't keep the passes after it
+   from running on the same memory. */
+int focus_test(struct worker *w, struct test *t, ulv *base, size_t words) {
+    unsigned int p, passes = t->passes ? t->passes : 1;
+    int failed = 0;
+
+    for (p = 0; p < passes && !soak_stop; p++) {
+        if (t->passes) {
+            w->pass_first = p;
+            w->pass_end = p + 1;
+        }
+        if (!(t->flags & TEST_OVERWRITES)) {
+            memset((void *) base, 255, words * sizeof(ul));
+        }
+        if (t->flags & (TEST_ADDRESS | TEST_PATTERN)) {
+            failed |= test_run(t, base, NULL, words) != 0;
+        } else {
+            failed |= test_run(t, base, base + words / 2, words / 2) != 0;
+        }
+    }
+    w->pass_first = w->pass_end = 0;
+    return failed;
+}
+
+/* Sweep the windows of the job in w's slice with the stuck address test and
+   every test in tests[], FOCUS_REPEATS times over.  Neither a failing test
+   nor a failing pass stops the sweep, so that every pattern gets to run on
+   the failing memory. */
+int run_focus(struct worker *w, void *arg) {
+    struct focus_job *job = (struct focus_job *) arg;
+    unsigned int i, r, k;
+    size_t words;
+    ulv *base;
+    ull stream;
+    int failed = 0;
+
+    for (i = 0; i < job->n; i++) {
+        if (job->offset[i] < w->offset ||
+            job->offset[i] >= w->offset + w->bytes) {
+            continue;
+        }
+        base = (ulv *) ((size_t) w->base + job->offset[i] - w->offset);
+        words = job->bytes[i] / sizeof(ul);
+        for (r = 0; r < FOCUS_REPEATS && !soak_stop; r++) {
+            stream = rng_key(rng_key(job->loop, job->offset[i]), r);
+            rng_init(stream);
+            failed |= focus_test(w, &stuck_address, base, words);
+            for (k = 0; tests[k].name && !soak_stop; k++) {
+                rng_init(rng_key(stream, k + 1));
+                failed |= focus_test(w, &tests[k], base, words);
+            }
+        }
+    }
+    return failed;
+}
+
+/* After a test has failed, sweep the FOCUS_PAGES pages it failed in most,
+   and FOCUS_NEIGHBOURS pages either side of each, with every test, and
+   report that as a test of its own. */
+void follow_up_failures(ul loop) {
+    size_t pages[FOCUS_PAGES], page = sysconf(_SC_PAGE_SIZE);
+    size_t t, start, end, lo, hi, swept = 0;
+    struct focus_job job;
+    struct worker *w, *s;
+    unsigned int i, j, n;
+    char label[64];
+    double begin;
+    int failed;
+
+    if (!(n = errors_worst_pages(pages, FOCUS_PAGES))) {
+        return;
+    }
+    for (i = 1; i < n; i++) {
+        for (j = i; j > 0 && pages[j - 1] > pages[j]; j--) {
+            t = pages[j];
+            pages[j] = pages[j - 1];
+            pages[j - 1] = t;
+        }
+    }
+    job.loop = loop;
+    job.n = 0;
+    for (i = 0; i < n; i++) {
+        /* The slice the page is in. */
+        for (w = NULL, j = 0; j < workers_count() && !w; j++) {
+            s = workers_get(j);
+            if (pages[i] >= s->offset && pages[i] < s->offset + s->bytes) {
+                w = s;
+            }
+        }
+        if (!w) {
+            continue;
+        }
+        lo = w->offset;
+        hi = w->offset + w->bytes;
+        start = pages[i] > lo + FOCUS_NEIGHBOURS * page ?
+            pages[i] - FOCUS_NEIGHBOURS * page : lo;
+        end = hi - pages[i] > (FOCUS_NEIGHBOURS + 1) * page ?
+            pages[i] + (FOCUS_NEIGHBOURS + 1) * page : hi;
+        if (job.n && job.offset[job.n - 1] >= lo &&
+            start <= job.offset[job.n - 1] + job.bytes[job.n - 1]) {
+            /* Overlaps the window before, in the same slice. */
+            job.bytes[job.n - 1] = end - job.offset[job.n - 1];
+        } else {
+            job.offset[job.n] = start;
+            job.bytes[job.n++] = end - start;
+        }
+    }
+    for (i = 0; i < job.n; i++) {
+        swept += job.bytes[i];
+    }
+    snprintf(label, sizeof(label), "%s (%luK)", follow_up.name,
+             (ul) (swept >> 10));
+    printf("  %-20s: ", label);
+    fflush(stdout);
+    errors_begin_test(follow_up.name, loop);
+    if (ecc) {
+        edac_begin_test();
+    }
+    soak_status.test = label;
+    workers_clear();
+    begin = monotonic_seconds();
+    failed = workers_run(run_focus, &job);
+    soak_status.test = NULL;
+    if (report_result(loop, &follow_up, "linear", failed,
+                      monotonic_seconds() - begin) && ecc == ECC_FAIL) {
+        progress.exit_code |= EXIT_FAIL_CORRECTED;
+    }
+    fflush(stdout);
+}
+
+/* Run one repetition of one test in one access order on all workers, chunk
+   by chunk from chunk 'from', and report its result, following it up if
+   it failed with --adaptive.  Returns non-zero if testing was
+   interrupted. */
+int run_step(struct test_job *job, const char *label, ul from) {
+    const char *name = job->test->name;
+    int fail = (job->test->flags & TEST_ADDRESS) ? EXIT_FAIL_ADDRESSLINES
+                                                 : EXIT_FAIL_OTHERTEST;
+    /* Without a checkpoint to save, hand out all the chunks at once. */
+    ul step = checkpoint_path ? 1 : nchunks;
+    int failed = 0;
+    double start;
+    ul c;
+
+    if (ecc) {
+        edac_begin_test();
+    }
+    /* clear buffer, unless the test overwrites all of it */
+    if (!(job->test->flags & TEST_OVERWRITES)) {
+        workers_run(run_reset, NULL);
+    }
+    printf("  %-20s: ", label);
+    fflush(stdout);
+    errors_begin_test(name, job->loop);
+    soak_status.test = label;
+    workers_clear();
+    out_progress_begin(workers_pieces(nchunks - from, job->test->passes));
+    start = monotonic_seconds();
+    for (c = from; c < nchunks; c += step) {
+        failed |= workers_run_items(run_test, job, c,
+                                    c + step < nchunks ? c + step : nchunks,
+                                    job->test->passes);
+        if (soak_stop) {
+            break;
+        }
+        if (checkpoint_path) {
+            progress.loop = job->loop;
+            progress.test = job->index;
+            progress.repeat = job->repeat;
+            progress.order = job->order;
+            progress.next_chunk = c + step;
+            if (failed) {
+                progress.exit_code |= fail;
+            }
+            checkpoint_save(checkpoint_path, &progress);
+        }
+    }
+    out_progress_end();
+    soak_status.test = NULL;
+    if (soak_stop) {
+        printf("interrupted\n");
+        return 1;
+    }
+    if (report_result(job->loop, job->test,
+                      (job->test->flags & TEST_ADDRESS) ? "linear"
+                                                        : order->name,
+                      failed, monotonic_seconds() - start) &&
+        ecc == ECC_FAIL) {
+        progress.exit_code |= EXIT_FAIL_CORRECTED;
+    }
+    if (failed) {
+        progress.exit_code |= fail;
+    }
+    fflush(stdout);
+    if (failed && adaptive) {
+        follow_up_failures(job->loop);
+    }
+    return 0;
+}
+
+long get_free_hugepages(size_t size) {
+	char path[96];
+	FILE *file;
 	long free_hugepages = 0;
 
+	snprintf(path, sizeof(path), HUGEPAGES_SYSFS "/hugepages-%lukB/free_hugepages",
+			 (ul) (size >> 10));
+	file = fopen(path, "r");
 	if (file == NULL) {
 		perror("Error opening file");
 		return -1;
@@ -146,121 +624,568 @@ long get_free_hugepages(void) {
 	return free_hugepages;
 }
 
-void alloc_using_hugepages(memory_alloc_t *alloc) {
-	long free_hugepages = get_free_hugepages();
+/* Choose the hugepage size for -H auto: the largest size whose free pool
+   holds all of wantbytes or, if none does, the size with the most free
+   memory.  Returns 0 if there are no free hugepages of any size. */
+size_t auto_hugepagesize(size_t wantbytes) {
+    DIR *dir = opendir(HUGEPAGES_SYSFS);
+    struct dirent *entry;
+    size_t size, best = 0;
+    ull have, best_have = 0;
+    int covers, best_covers = 0;
+    long free_hugepages;
+    ul kb;
 
-	if (alloc->wantbytes % alloc->pagesize != 0) {
-        alloc->wantbytes = ((alloc->wantbytes / alloc->pagesize) + 1) * alloc->pagesize;
+    if (dir == NULL) {
+        return 0;
     }
+    while ((entry = readdir(dir))) {
+        if (sscanf(entry->d_name, "hugepages-%lukB", &kb) != 1) {
+            continue;
+        }
+        size = (size_t) kb << 10;
+        if ((free_hugepages = get_free_hugepages(size)) <= 0) {
+            continue;
+        }
+        have = (ull) free_hugepages * size;
+        covers = have >= wantbytes;
+        if (!best || covers > best_covers || (covers == best_covers &&
+            (covers ? size > best : have > best_have))) {
+            best = size;
+            best_have = have;
+            best_covers = covers;
+        }
+    }
+    closedir(dir);
+    return best;
+}
+
+/* Parse the -H argument: auto (or none), thp, or a size like 2M or 1G. */
+int parse_hugepages(const char *arg, memory_alloc_t *alloc) {
+    char *suffix;
+    ul size;
+
+    alloc->use_hugepages = 1;
+    alloc->use_thp = 0;
+    alloc->hugepagesize = 0;
+    if (!arg || !strcmp(arg, "auto")) {
+        return 0;
+    }
+    if (!strcmp(arg, "thp")) {
+        alloc->use_hugepages = 0;
+        alloc->use_thp = 1;
+        return 0;
+    }
+    errno = 0;
+    size = strtoul(arg, &suffix, 0);
+    switch (*suffix) {
+        case 'G':
+        case 'g':
+            size <<= 10;
+            /* fall through */
+        case 'M':
+        case 'm':
+            size <<= 10;
+            /* fall through */
+        case 'K':
+        case 'k':
+            size <<= 10;
+            suffix++;
+            break;
+    }
+    if (errno != 0 || *suffix != '\0' || size < 4096 ||
+        (size & (size - 1))) {
+        fprintf(stderr, "bad hugepage size %s\n", arg);
+        return -1;
+    }
+    alloc->hugepagesize = size;
+    return 0;
+}
 
-    while (!alloc->buf && alloc->wantbytes) {
-        alloc->buf = mmap(NULL, alloc->wantbytes, PROT_READ | PROT_WRITE,
-                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+/* Ask for transparent huge pages on the page-aligned part of the buffer,
+   before its pages are first touched. */
+void advise_thp(memory_alloc_t *alloc) {
+#ifdef MADV_HUGEPAGE
+    size_t start = ((size_t) alloc->buf + alloc->pagesize - 1) &
+        alloc->pagesizemask;
+    size_t end = ((size_t) alloc->buf + alloc->wantbytes) &
+        alloc->pagesizemask;
 
-        if (alloc->buf == MAP_FAILED && errno == ENOMEM) {
-			alloc->buf = NULL;
+    if (end > start && madvise((void *) start, end - start, MADV_HUGEPAGE) < 0) {
+        perror("madvise(MADV_HUGEPAGE) failed");
+    }
+#endif
+}
 
-			if (free_hugepages > 0 && alloc->wantbytes > (free_hugepages * alloc->pagesize)) {
-				alloc->wantbytes = free_hugepages * alloc->pagesize;
-			} else {
-				alloc->wantbytes -= alloc->pagesize;
-			}
+/* The most memory worth trying to lock: what the kernel reports as
+   available, and RLIMIT_MEMLOCK unless we are root (and so not subject to
+   it).  Returns (size_t) -1 if neither is known. */
+size_t lockable_bytes(void) {
+    size_t limit = (size_t) -1;
+    FILE *file = fopen("/proc/meminfo", "r");
+    char line[128];
+    ul kb;
+    struct rlimit rl;
 
-            if (alloc->wantbytes < alloc->pagesize) {
-                fprintf(stderr, "insufficient memory available for huge page allocation\n");
+    if (file != NULL) {
+        while (fgets(line, sizeof(line), file)) {
+            if (sscanf(line, "MemAvailable: %lu kB", &kb) == 1) {
+                limit = (size_t) kb << 10;
                 break;
             }
-        } else if (alloc->buf == MAP_FAILED) {
-			perror("mmap failed for huge pages, ");
-			exit(EXIT_FAILURE);
-		} else {
-			printf("got  %lluMB (%llu bytes)", (ull) alloc->wantbytes >> 20,
-				   (ull) alloc->wantbytes);
-		}
-    }
-	printf("\n");
+        }
+        fclose(file);
+    }
+    if (geteuid() != 0 && !getrlimit(RLIMIT_MEMLOCK, &rl) &&
+        rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur < limit) {
+        limit = rl.rlim_cur;
+    }
+    return limit;
+}
+
+/* Lock [buf, buf + size), faulting it in unless lock_on_fault is set; then
+   the pages are locked as the workers first touch them. */
+int lock_buffer(memory_alloc_t *alloc, void *buf, size_t size) {
+#ifdef SYS_mlock2
+    if (alloc->lock_on_fault) {
+        if (!syscall(SYS_mlock2, buf, size, MLOCK_ONFAULT)) {
+            return 0;
+        }
+        if (errno != ENOSYS && errno != EINVAL) {
+            return -1;
+        }
+        /* Older kernel: fault everything in here after all. */
+        alloc->lock_on_fault = 0;
+    }
+#endif
+    return mlock(buf, size);
+}
+
+/* Map size bytes and, if do_mlock is set, lock them, which also faults them
+   in.  On failure nothing is left mapped and errno tells why. */
+int try_alloc(memory_alloc_t *alloc, size_t size) {
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    void *buf;
+    int saved;
+
+    if (alloc->use_hugepages) {
+        flags |= MAP_HUGETLB |
+            (__builtin_ctzl(alloc->pagesize) << MAP_HUGE_SHIFT);
+    }
+    buf = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (buf == MAP_FAILED) {
+        return -1;
+    }
+    alloc->buf = buf;
+    alloc->wantbytes = size;
+    if (alloc->use_thp) {
+        advise_thp(alloc);
+    }
+    if (alloc->do_mlock && lock_buffer(alloc, buf, size) < 0) {
+        saved = errno;
+        munmap(buf, size);
+        alloc->buf = NULL;
+        errno = saved;
+        return -1;
+    }
+    return 0;
 }
 
-int alloc_using_malloc(memory_alloc_t *alloc, const size_t wantbytes_orig) {
-    while (!alloc->buf && alloc->wantbytes) {
-        alloc->buf = (void volatile *) malloc(alloc->wantbytes);
-        if (!alloc->buf) alloc->wantbytes -= alloc->pagesize;
+/*
+ * Allocate the test buffer.  The request is first cut down to what can be
+ * locked (or to the free hugepage pool); if that still fails for lack of
+ * memory, binary-search the largest size that can be had, to within
+ * 1/256th, rather than shrinking a page at a time.  Every failed try is
+ * unmapped at once, so each costs at most one pass of page faults.
+ */
+int alloc_using_mmap(memory_alloc_t *alloc, const size_t wantbytes_orig) {
+    size_t lo = 0, hi, mid, limit = (size_t) -1;
+    long free_hugepages;
+
+    if (alloc->use_hugepages) {
+        if (alloc->wantbytes % alloc->pagesize != 0) {
+            alloc->wantbytes = ((alloc->wantbytes / alloc->pagesize) + 1) *
+                alloc->pagesize;
+        }
+        if ((free_hugepages = get_free_hugepages(alloc->pagesize)) > 0) {
+            limit = free_hugepages * alloc->pagesize;
+        }
+    } else if (alloc->do_mlock) {
+        limit = lockable_bytes() & alloc->pagesizemask;
+    }
+    if (alloc->wantbytes > limit) {
+        printf("only %lluMB %s, reducing...\n", (ull) limit >> 20,
+               alloc->use_hugepages ? "in free hugepages" : "can be locked");
+        alloc->wantbytes = limit;
     }
-    alloc->bufsize = alloc->wantbytes;
     printf("got  %lluMB (%llu bytes)", (ull) alloc->wantbytes >> 20,
         (ull) alloc->wantbytes);
-    fflush(stdout);
+    if (alloc->use_hugepages) {
+        printf(" in %luMB hugepages", (ul) (alloc->pagesize >> 20));
+    }
     if (alloc->do_mlock) {
         printf(", trying mlock ...");
-        fflush(stdout);
-        if ((size_t) alloc->buf % alloc->pagesize) {
-            /* printf("aligning to page -- was 0x%tx\n", buf); */
-            alloc->aligned = (void volatile *) ((size_t) alloc->buf &
-                    alloc->pagesizemask) + alloc->pagesize;
-            /* printf("  now 0x%tx -- lost %d bytes\n", aligned,
-             *      (size_t) aligned - (size_t) buf);
-             */
-            alloc->bufsize -= ((size_t) alloc->aligned - (size_t) alloc->buf);
+    }
+    fflush(stdout);
+    if (!try_alloc(alloc, alloc->wantbytes)) {
+        printf(alloc->do_mlock ? "locked.\n" : "\n");
+        return 0;
+    }
+    switch (errno) {
+        case EPERM:
+            printf("insufficient permission.\n");
+            printf("Trying again, unlocked:\n");
+            alloc->do_mlock = 0;
+            alloc->wantbytes = wantbytes_orig;
+            return alloc_using_mmap(alloc, wantbytes_orig);
+        case EAGAIN: /* BSDs */
+        case ENOMEM:
+            break;
+        default:
+            perror("failed for unknown reason");
+            return -1;
+    }
+    printf("too many pages, searching...");
+    fflush(stdout);
+    hi = alloc->wantbytes;
+    while (hi - lo > alloc->pagesize && hi - lo > (hi >> 8)) {
+        mid = (lo + (hi - lo) / 2) & alloc->pagesizemask;
+        if (mid <= lo) {
+            break;
+        }
+        if (try_alloc(alloc, mid)) {
+            hi = mid;
         } else {
-            alloc->aligned = alloc->buf;
-        }
-        /* Try mlock */
-        if (mlock((void *) alloc->aligned, alloc->bufsize) < 0) {
-            switch(errno) {
-                case EAGAIN: /* BSDs */
-                    printf("over system/pre-process limit, reducing...\n");
-                    free((void *) alloc->buf);
-                    alloc->buf = NULL;
-                    alloc->wantbytes -= alloc->pagesize;
-                    break;
-                case ENOMEM:
-                    printf("too many pages, reducing...\n");
-                    free((void *) alloc->buf);
-                    alloc->buf = NULL;
-                    alloc->wantbytes -= alloc->pagesize;
-                    break;
-                case EPERM:
-                    printf("insufficient permission.\n");
-                    printf("Trying again, unlocked:\n");
-                    alloc->do_mlock = 0;
-                    free((void *) alloc->buf);
-                    alloc->buf = NULL;
-                    alloc->wantbytes = wantbytes_orig;
-                    break;
-                default:
-                    printf("failed for unknown reason.\n");
-                    alloc->do_mlock = 0;
-                    return 1;
+            munmap((void *) alloc->buf, mid);
+            alloc->buf = NULL;
+            lo = mid;
+        }
+    }
+    if (!lo || try_alloc(alloc, lo)) {
+        printf("failed.\n");
+        return -1;
+    }
+    printf("got %lluMB (%llu bytes)%s.\n", (ull) lo >> 20, (ull) lo,
+           alloc->do_mlock ? ", locked" : "");
+    return 0;
+}
+
+/* The mapping alignment of the device-dax character device st, from sysfs,
+   or 0 if it is not one. */
+size_t dax_device_align(const struct stat *st) {
+    char path[96], link[256], *name;
+    size_t align = DAX_ALIGN;
+    ssize_t n;
+    FILE *file;
+    ul a;
+
+    if (!S_ISCHR(st->st_mode)) {
+        return 0;
+    }
+    snprintf(path, sizeof(path), "/sys/dev/char/%u:%u/subsystem",
+             major(st->st_rdev), minor(st->st_rdev));
+    if ((n = readlink(path, link, sizeof(link) - 1)) < 0) {
+        return 0;
+    }
+    link[n] = '\0';
+    name = strrchr(link, '/') ? strrchr(link, '/') + 1 : link;
+    if (strcmp(name, "dax")) {
+        return 0;
+    }
+    snprintf(path, sizeof(path), "/sys/dev/char/%u:%u/align",
+             major(st->st_rdev), minor(st->st_rdev));
+    if ((file = fopen(path, "r"))) {
+        if (fscanf(file, "%lu", &a) == 1 && a && !(a & (a - 1))) {
+            align = a;
+        }
+        fclose(file);
+    }
+    return align;
+}
+
+/*
+ * Map the -p ranges, bytes of each, one after the other into a stretch of
+ * address space reserved for them, so that they are tested as one buffer
+ * (with workers of their own, see workers_start()).  Device-dax devices
+ * need their mappings aligned, which every range is then cut down to, and
+ * are mapped with MAP_SYNC and without O_SYNC: DAX memory is cacheable, so
+ * it is tested at full speed.  A regular file is taken to be on a DAX file
+ * system if it can be mapped with MAP_SYNC.  Exits on failure.
+ */
+void map_ranges(memory_alloc_t *alloc, size_t bytes, int o_flags) {
+    size_t align = alloc->pagesize, off;
+    struct phys_range *r;
+    struct stat st;
+    char *reserve, *start;
+    void *at;
+    unsigned int i;
+    int fd;
+
+    for (i = 0; i < n_phys_ranges; i++) {
+        r = &phys_ranges[i];
+        r->dax_align = 0;
+        if (!stat(r->device, &st)) {
+            r->dax_align = dax_device_align(&st);
+        }
+        if (r->dax_align > align) {
+            align = r->dax_align;
+        }
+        if (r->dax_align && r->base % r->dax_align) {
+            fprintf(stderr, "offset 0x%llx in %s is not a multiple of its "
+                    "%lu-byte alignment\n", (ull) r->base, r->device,
+                    (ul) r->dax_align);
+            exit(EXIT_FAIL_NONSTARTER);
+        }
+    }
+    bytes -= bytes % align;
+    if (!bytes) {
+        fprintf(stderr, "memory argument is less than the %lu-byte "
+                "alignment of DAX memory\n", (ul) align);
+        exit(EXIT_FAIL_NONSTARTER);
+    }
+    reserve = mmap(NULL, bytes * n_phys_ranges + align, PROT_NONE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (reserve == MAP_FAILED) {
+        perror("failed to reserve address space for physical memory");
+        exit(EXIT_FAIL_NONSTARTER);
+    }
+    start = (char *) (((size_t) reserve + align - 1) & ~(align - 1));
+    for (i = 0, off = 0; i < n_phys_ranges; i++, off += bytes) {
+        r = &phys_ranges[i];
+        fd = open(r->device, r->dax_align ? O_RDWR : o_flags);
+        if (fd == -1) {
+            fprintf(stderr, "failed to open %s for physical memory: %s\n",
+                    r->device, strerror(errno));
+            exit(EXIT_FAIL_NONSTARTER);
+        }
+        at = MAP_FAILED;
+        if (r->dax_align || (!fstat(fd, &st) && S_ISREG(st.st_mode))) {
+            at = mmap(start + off, bytes, PROT_READ | PROT_WRITE,
+                      MAP_SHARED_VALIDATE | MAP_SYNC | MAP_FIXED, fd,
+                      r->base);
+            if (at != MAP_FAILED && !r->dax_align) {
+                r->dax_align = alloc->pagesize;
             }
-        } else {
-            printf("locked.\n");
-            return 1;
         }
-    } else {
-        printf("\n");
-        return 1;
+        if (at == MAP_FAILED) {
+            at = mmap(start + off, bytes, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_LOCKED | MAP_FIXED, fd, r->base);
+        }
+        if (at == MAP_FAILED) {
+            fprintf(stderr, "failed to mmap %s for physical memory: %s\n",
+                    r->device, strerror(errno));
+            exit(EXIT_FAIL_NONSTARTER);
+        }
+        close(fd);
+        r->offset = off;
+        r->bytes = bytes;
+        printf("mapped %lluMB at 0x%llx of %s%s\n", (ull) bytes >> 20,
+               (ull) r->base, r->device, r->dax_align ? " (DAX, MAP_SYNC)" : "");
     }
+    alloc->buf = start;
+    alloc->bufsize = bytes * n_phys_ranges;
+}
+
+/* With --elastic, <mem> is only the most tested; see elastic.c. */
+static int use_elastic = 0;
+static struct elastic elastic;
+
+/* Reserve wantbytes for --elastic and map as much of them as the host can
+   spare now, unlocked if mlock is not permitted, and a step less at a time
+   if even that much can't be had. */
+int alloc_elastic(memory_alloc_t *alloc) {
+    size_t target;
 
+    if (elastic_reserve(&elastic, alloc->wantbytes, alloc->pagesize,
+                        alloc->do_mlock) < 0) {
+        perror("failed to reserve address space");
+        return -1;
+    }
+    target = elastic_target(&elastic);
+    while (elastic_resize(&elastic, target) < 0) {
+        if (errno == EPERM && elastic.lock) {
+            printf("insufficient permission to mlock; trying unlocked\n");
+            elastic.lock = alloc->do_mlock = 0;
+            continue;
+        }
+        if ((errno != ENOMEM && errno != EAGAIN) || target <= ELASTIC_STEP) {
+            perror("failed to map memory");
+            return -1;
+        }
+        target -= ELASTIC_STEP;
+    }
+    alloc->buf = (void volatile *) elastic.base;
+    alloc->bufsize = elastic.bytes;
+    printf("elastic: up to %lluMB, testing %lluMB now%s\n",
+           (ull) elastic.max >> 20, (ull) elastic.bytes >> 20,
+           elastic.lock ? ", locked" : "");
     return 0;
 }
 
+/* Cut every slice into chunks of each half, so that a long run can be
+   stopped and resumed between them, and so that idle workers can take
+   over chunks from busy ones. */
+void count_chunks(size_t chunk) {
+    struct worker *w;
+    unsigned int i;
+
+    nchunks = 1;
+    for (i = 0; chunk && i < workers_count(); i++) {
+        w = workers_get(i);
+        if ((w->count * sizeof(ul) + chunk - 1) / chunk > nchunks) {
+            nchunks = (w->count * sizeof(ul) + chunk - 1) / chunk;
+        }
+    }
+}
+
+/* Before each step of an elastic run, grow or shrink the buffer to what the
+   host can spare now, and restart the workers on it if it changed.  A step
+   never reads what it has not written, so the new slices need no more
+   than the reset run_step() gives them. */
+void elastic_adjust(memory_alloc_t *alloc, unsigned int nthreads,
+                    int use_numa, size_t chunk, double bandwidth,
+                    double duty) {
+    size_t target = elastic_target(&elastic), was = elastic.bytes;
+
+    if (target == was) {
+        return;
+    }
+    if (elastic_resize(&elastic, target) < 0) {
+        /* Try again before the next step. */
+        return;
+    }
+    printf("elastic: %s to %lluMB\n", target > was ? "growing" : "shrinking",
+           (ull) target >> 20);
+    fflush(stdout);
+    alloc->bufsize = elastic.bytes;
+    workers_stop();
+    workers_start(nthreads, alloc->aligned, alloc->bufsize, alloc->pagesize,
+                  use_numa, NULL, 0);
+    soak_set_limits(bandwidth, duty / 100, workers_count());
+    count_chunks(chunk);
+}
+
+/* With --processes, start the coordinator and its processes, one per NUMA
+   node, per -p range or per share of <mem>, and narrow what this process
+   tests down to its own; returns the descriptor to write its records to.
+   The coordinator itself exits from here once they are all done. */
+int run_processes(const char *spec, memory_alloc_t *alloc,
+                  const char *report_format, const char *report_path) {
+    char labels[COORD_MAX][COORD_LABEL], *end;
+    int nodes[NODE_MAX];
+    unsigned int n, i;
+    int k, code, records = -1, by_node = 0;
+
+    if (report_format && strcmp(report_format, "text") &&
+        strcmp(report_format, "json") && strcmp(report_format, "csv")) {
+        fprintf(stderr, "unknown output format %s\n", report_format);
+        exit(EXIT_FAIL_NONSTARTER);
+    }
+    if (!strcmp(spec, "nodes")) {
+        if ((k = node_list(nodes, NODE_MAX)) < 1) {
+            fprintf(stderr, "no NUMA nodes found\n");
+            exit(EXIT_FAIL_NONSTARTER);
+        }
+        n = (unsigned int) k;
+        for (i = 0; i < n; i++) {
+            snprintf(labels[i], COORD_LABEL, "node %d", nodes[i]);
+        }
+        by_node = 1;
+    } else if (!strcmp(spec, "ranges")) {
+        n = n_phys_ranges;
+        for (i = 0; i < n; i++) {
+            snprintf(labels[i], COORD_LABEL, "range %u", i);
+        }
+    } else {
+        n = (unsigned int) strtoul(spec, &end, 0);
+        if (*end || !n || n > COORD_MAX) {
+            fprintf(stderr, "--processes takes 1 to %d, nodes or ranges\n",
+                    COORD_MAX);
+            exit(EXIT_FAIL_NONSTARTER);
+        }
+        for (i = 0; i < n; i++) {
+            snprintf(labels[i], COORD_LABEL, "process %u", i);
+        }
+    }
+    if (n > COORD_MAX) {
+        fprintf(stderr, "at most %d processes\n", COORD_MAX);
+        exit(EXIT_FAIL_NONSTARTER);
+    }
+    /* -p ranges are <mem> each; otherwise the processes share <mem>. */
+    if (!use_phys) {
+        alloc->wantbytes = (alloc->wantbytes / n) & alloc->pagesizemask;
+        if (alloc->wantbytes < alloc->pagesize) {
+            fprintf(stderr, "memory argument too small for %u processes\n",
+                    n);
+            exit(EXIT_FAIL_NONSTARTER);
+        }
+    }
+    printf("coordinating %u processes, %lluMB each\n", n,
+           (ull) alloc->wantbytes >> 20);
+    if ((k = coordinator_start(n, labels, alloc->wantbytes, &records)) < 0) {
+        exit(EXIT_FAIL_NONSTARTER);
+    }
+    if (k == (int) n &&
+        (k = coordinator_wait(report_format, report_path, &records,
+                              &code)) < 0) {
+        exit(code);
+    }
+    if (by_node && node_run_on(nodes[k]) < 0) {
+        perror("failed to bind to the node");
+        exit(EXIT_FAIL_NONSTARTER);
+    }
+    if (use_phys) {
+        phys_ranges[0] = phys_ranges[k];
+        n_phys_ranges = 1;
+    }
+    out_progress_disable();
+    return records;
+}
+
 int main(int argc, char **argv) {
     ul loops, loop, i;
-    size_t wantraw, wantmb, wantbytes_orig, halflen, count;
-    char *memsuffix, *addrsuffix, *loopsuffix;
-    ulv *bufa, *bufb;
+    size_t wantraw, wantmb, wantbytes_orig;
+    char *memsuffix, *addrsuffix, *loopsuffix, *threadsuffix, *seedsuffix,
+         *limitsuffix;
     int done_mem = 0;
-    int exit_code = 0;
-    int memfd, opt, memshift;
+    int opt, memshift;
     size_t maxbytes = -1; /* addressable memory, in bytes */
     size_t maxmb = (maxbytes >> 20) + 1; /* addressable memory, in MB */
-    /* Device to mmap memory from with -p, default is normal core */
-    char *device_name = "/dev/mem";
+    /* Devices to mmap memory from with -p, default is normal core; the
+       n-th -d goes with the n-th -p, and later ones use the last given */
+    char *devices[PHYS_RANGES_MAX];
+    unsigned int n_devices = 0;
+    off_t addr;
+    size_t parts[PHYS_RANGES_MAX];
     struct stat statbuf;
-    int device_specified = 0;
     char *env_testmask;
     ul testmask = 0;
     int o_flags = O_RDWR | O_SYNC;
+    unsigned int nthreads = 1;
+    int use_numa = 0;
+    int seed_specified = 0;
+    char *kernels_name = NULL;
+    unsigned int width = 0;
+    int nontemporal = 0;
+    char *report_format = NULL, *report_path = NULL;
+    char *metrics_path = NULL;
+    char *procs_spec = NULL;
+    int records = -1;
+    struct test_job job;
+    char *tests_spec = NULL;
+    struct test_step plan[PLAN_MAX];
+    int nplan;
+    ul p, r;
+    char *order_spec = "linear";
+    struct order orders[ORDER_MAX];
+    int norders, k, n;
+    char label[64];
+    int resume = 0;
+    size_t chunk = 0;
+    ul from;
+    int soak = 0;
+    int characterize = 0;
+    double bandwidth = 0, duty = 0;
     memory_alloc_t alloc = {
             .buf = NULL,
             .aligned = NULL,
@@ -273,13 +1198,6 @@ int main(int argc, char **argv) {
     memtester_pagesize(&alloc);
     out_initialize();
 
-    printf("memtester version " __version__ " (%d-bit)\n", UL_LEN);
-    printf("Copyright (C) 2001-2020 Charles Cazabon.\n");
-    printf("Licensed under the GNU General Public License version 2 (only).\n");
-    printf("\n");
-    check_posix_system();
-    printf("pagesizemask is 0x%tx\n", alloc.pagesizemask);
-
     /* If MEMTESTER_TEST_MASK is set, we use its value as a mask of which
        tests we run.
      */
@@ -291,18 +1209,20 @@ int main(int argc, char **argv) {
                     env_testmask, strerror(errno));
             return usage(argv[0]);
         }
-        printf("using testmask 0x%lx\n", testmask);
     }
 
-    while ((opt = getopt(argc, argv, "Hp:d:u")) != -1) {
+    while ((opt = getopt_long(argc, argv, "H::p:d:ut:N", long_options,
+                              NULL)) != -1) {
         switch (opt) {
             case 'H':
-                alloc.use_hugepages = 1;
-                memtester_pagesize(&alloc);
+            case OPT_HUGEPAGES:
+                if (parse_hugepages(optarg, &alloc) < 0) {
+                    return usage(argv[0]);
+                }
                 break;
             case 'p':
                 errno = 0;
-                physaddrbase = (off_t) strtoull(optarg, &addrsuffix, 16);
+                addr = (off_t) strtoull(optarg, &addrsuffix, 16);
                 if (errno != 0) {
                     fprintf(stderr,
                             "failed to parse physaddrbase arg; should be hex "
@@ -316,13 +1236,22 @@ int main(int argc, char **argv) {
                             "address (0x123...)\n");
                     return usage(argv[0]);
                 }
-                if (physaddrbase & (alloc.pagesize - 1)) {
+                if (addr & (alloc.pagesize - 1)) {
                     fprintf(stderr,
                             "bad physaddrbase arg; does not start on page "
                             "boundary\n");
                     return usage(argv[0]);
                 }
+                if (n_phys_ranges == PHYS_RANGES_MAX) {
+                    fprintf(stderr, "at most %d ranges (-p)\n",
+                            PHYS_RANGES_MAX);
+                    return usage(argv[0]);
+                }
                 /* okay, got address */
+                if (!n_phys_ranges) {
+                    physaddrbase = addr;
+                }
+                phys_ranges[n_phys_ranges++].base = addr;
                 use_phys = 1;
                 break;
             case 'd':
@@ -331,29 +1260,241 @@ int main(int argc, char **argv) {
                             strerror(errno));
                     return usage(argv[0]);
                 } else {
-                    if (!S_ISCHR(statbuf.st_mode)) {
+                    /* Regular files are allowed for DAX file systems. */
+                    if (!S_ISCHR(statbuf.st_mode) &&
+                        !S_ISREG(statbuf.st_mode)) {
                         fprintf(stderr, "can not mmap non-char device %s\n",
                                 optarg);
                         return usage(argv[0]);
+                    } else if (n_devices == PHYS_RANGES_MAX) {
+                        fprintf(stderr, "at most %d devices (-d)\n",
+                                PHYS_RANGES_MAX);
+                        return usage(argv[0]);
                     } else {
-                        device_name = optarg;
-                        device_specified = 1;
+                        devices[n_devices++] = optarg;
                     }
                 }
                 break;
             case 'u':
                 o_flags &= ~O_SYNC;
                 break;
+            case 't':
+                errno = 0;
+                nthreads = (unsigned int) strtoul(optarg, &threadsuffix, 0);
+                if (errno != 0 || *threadsuffix != '\0') {
+                    fprintf(stderr, "failed to parse number of threads\n");
+                    return usage(argv[0]);
+                }
+                if (!nthreads) {
+                    nthreads = workers_available_cpus();
+                }
+                break;
+            case 'N':
+                use_numa = 1;
+                break;
+            case OPT_SEED:
+                errno = 0;
+                rng_seed = strtoull(optarg, &seedsuffix, 0);
+                if (errno != 0 || *seedsuffix != '\0') {
+                    fprintf(stderr, "failed to parse seed\n");
+                    return usage(argv[0]);
+                }
+                seed_specified = 1;
+                break;
+            case OPT_KERNELS:
+                kernels_name = optarg;
+                break;
+            case OPT_WIDTH:
+                errno = 0;
+                width = (unsigned int) strtoul(optarg, &limitsuffix, 0);
+                if (errno != 0 || *limitsuffix != '\0' || !width) {
+                    fprintf(stderr, "failed to parse access width\n");
+                    return usage(argv[0]);
+                }
+                break;
+            case OPT_PREFAULT:
+                if (!strcmp(optarg, "threads")) {
+                    alloc.lock_on_fault = 1;
+                } else if (!strcmp(optarg, "lock")) {
+                    alloc.lock_on_fault = 0;
+                } else {
+                    fprintf(stderr, "unknown prefault mode %s\n", optarg);
+                    return usage(argv[0]);
+                }
+                break;
+            case OPT_SOAK:
+                soak = 1;
+                break;
+            case OPT_BANDWIDTH:
+                errno = 0;
+                bandwidth = strtod(optarg, &limitsuffix);
+                switch (*limitsuffix) {
+                    case 'G':
+                    case 'g':
+                        bandwidth *= 1024;
+                        /* fall through */
+                    case 'M':
+                    case 'm':
+                        bandwidth *= 1024;
+                        /* fall through */
+                    case 'K':
+                    case 'k':
+                        bandwidth *= 1024;
+                        limitsuffix++;
+                        break;
+                }
+                if (errno != 0 || *limitsuffix != '\0' || bandwidth <= 0) {
+                    fprintf(stderr, "failed to parse bandwidth\n");
+                    return usage(argv[0]);
+                }
+                break;
+            case OPT_DUTY:
+                errno = 0;
+                duty = strtod(optarg, &limitsuffix);
+                if (errno != 0 || *limitsuffix != '\0' || duty <= 0 ||
+                    duty > 100) {
+                    fprintf(stderr, "duty cycle must be a percentage\n");
+                    return usage(argv[0]);
+                }
+                break;
+            case OPT_CHECKPOINT:
+                checkpoint_path = optarg;
+                break;
+            case OPT_RESUME:
+                resume = 1;
+                break;
+            case OPT_CHUNK:
+                errno = 0;
+                chunk = (size_t) strtoul(optarg, &limitsuffix, 0);
+                switch (*limitsuffix) {
+                    case 'G':
+                    case 'g':
+                        chunk <<= 10;
+                        /* fall through */
+                    case 'M':
+                    case 'm':
+                    case '\0':
+                        chunk <<= 10;
+                        /* fall through */
+                    case 'K':
+                    case 'k':
+                        chunk <<= 10;
+                        if (*limitsuffix) {
+                            limitsuffix++;
+                        }
+                        break;
+                }
+                if (errno != 0 || *limitsuffix != '\0') {
+                    fprintf(stderr, "failed to parse chunk size\n");
+                    return usage(argv[0]);
+                }
+                chunk &= alloc.pagesizemask;
+                if (!chunk) {
+                    fprintf(stderr, "chunk size must be at least a page\n");
+                    return usage(argv[0]);
+                }
+                break;
+            case OPT_TESTS:
+                tests_spec = optarg;
+                break;
+            case OPT_CHARACTERIZE:
+                characterize = 1;
+                break;
+            case OPT_ELASTIC:
+                use_elastic = 1;
+                break;
+            case OPT_METRICS:
+                metrics_path = optarg;
+                break;
+            case OPT_PROCESSES:
+                procs_spec = optarg;
+                break;
+            case OPT_ECC:
+                if (!optarg) {
+                    ecc = ECC_REPORT;
+                } else if (!strcmp(optarg, "fail")) {
+                    ecc = ECC_FAIL;
+                } else {
+                    fprintf(stderr, "unknown --ecc mode %s\n", optarg);
+                    return usage(argv[0]);
+                }
+                break;
+            case OPT_ADAPTIVE:
+                adaptive = 1;
+                break;
+            case OPT_ORDER:
+                order_spec = optarg;
+                break;
+            case OPT_NONTEMPORAL:
+                nontemporal = 1;
+                break;
+            case OPT_FORMAT:
+                report_format = optarg;
+                break;
+            case OPT_REPORT:
+                report_path = optarg;
+                break;
+            case OPT_MAX_ERRORS:
+                errno = 0;
+                error_print_limit = strtoul(optarg, &limitsuffix, 0);
+                if (errno != 0 || *limitsuffix != '\0') {
+                    fprintf(stderr, "failed to parse max-errors\n");
+                    return usage(argv[0]);
+                }
+                break;
+            case OPT_VERIFY:
+                if (!strcmp(optarg, "expected")) {
+                    verify_expected = 1;
+                } else if (!strcmp(optarg, "mirror")) {
+                    verify_expected = 0;
+                } else {
+                    fprintf(stderr, "unknown verify mode %s\n", optarg);
+                    return usage(argv[0]);
+                }
+                break;
             default: /* '?' */
                 return usage(argv[0]);
         }
     }
 
-    if (device_specified && !use_phys) {
+    if (resume && !checkpoint_path) {
+        fprintf(stderr, "--resume needs --checkpoint\n");
+        return usage(argv[0]);
+    }
+    if (procs_spec && (checkpoint_path || metrics_path || use_elastic)) {
+        fprintf(stderr, "--processes does not go with --checkpoint, "
+                "--metrics or --elastic\n");
+        return usage(argv[0]);
+    }
+    if (procs_spec && !strcmp(procs_spec, "nodes") && (use_numa || use_phys)) {
+        fprintf(stderr, "--processes=nodes does not go with -N or -p\n");
+        return usage(argv[0]);
+    }
+    if (procs_spec &&
+        (strcmp(procs_spec, "ranges") == 0) != (use_phys != 0)) {
+        fprintf(stderr, "-p needs --processes=ranges, and it needs -p\n");
+        return usage(argv[0]);
+    }
+    if (use_elastic && (use_phys || checkpoint_path || alloc.use_hugepages ||
+                        alloc.use_thp)) {
+        fprintf(stderr, "--elastic does not go with -p, -H or "
+                "--checkpoint\n");
+        return usage(argv[0]);
+    }
+
+    if (n_devices && !use_phys) {
         fprintf(stderr,
                 "for mem device, physaddrbase (-p) must be specified\n");
         return usage(argv[0]);
     }
+    if (n_devices > n_phys_ranges) {
+        fprintf(stderr, "more devices (-d) than ranges (-p)\n");
+        return usage(argv[0]);
+    }
+    for (i = 0; i < n_phys_ranges; i++) {
+        phys_ranges[i].device = i < n_devices ? devices[i] :
+            i ? phys_ranges[i - 1].device : "/dev/mem";
+    }
 
     if (optind >= argc) {
         fprintf(stderr, "need memory argument, in MB\n");
@@ -392,6 +1533,22 @@ int main(int argc, char **argv) {
     wantbytes_orig = alloc.wantbytes = ((size_t) wantraw << memshift);
     wantmb = (wantbytes_orig >> 20);
     optind++;
+    if (alloc.use_hugepages && use_phys) {
+        fprintf(stderr, "hugepages (-H) do not apply to -p; ignoring them\n");
+        alloc.use_hugepages = 0;
+    }
+    if (alloc.use_hugepages && !alloc.hugepagesize) {
+        alloc.hugepagesize = auto_hugepagesize(alloc.wantbytes);
+        if (!alloc.hugepagesize) {
+            fprintf(stderr, "no free hugepages; using transparent huge "
+                    "pages instead\n");
+            alloc.use_hugepages = 0;
+            alloc.use_thp = 1;
+        }
+    }
+    if (alloc.use_hugepages) {
+        memtester_pagesize(&alloc);
+    }
     if (wantmb > maxmb) {
         fprintf(stderr, "This system can only address %llu MB.\n", (ull) maxmb);
         exit(EXIT_FAIL_NONSTARTER);
@@ -417,41 +1574,133 @@ int main(int argc, char **argv) {
         }
     }
 
-    printf("want %lluMB (%llu bytes)\n", (ull) wantmb, (ull) alloc.wantbytes);
-    alloc.buf = NULL;
+    if (report_path && !report_format) {
+        report_format = "json";
+    }
+    /* Records on stdout get it to themselves, the text going to stderr. */
+    if (report_format && (!strcmp(report_format, "json") ||
+                          !strcmp(report_format, "csv")) &&
+        (!report_path || !strcmp(report_path, "-"))) {
+        out_records_stdout();
+    }
 
-    if (use_phys) {
-        memfd = open(device_name, o_flags);
-        if (memfd == -1) {
-            fprintf(stderr, "failed to open %s for physical memory: %s\n",
-                    device_name, strerror(errno));
-            exit(EXIT_FAIL_NONSTARTER);
+    printf("memtester version " __version__ " (%d-bit)\n", UL_LEN);
+    printf("Copyright (C) 2001-2020 Charles Cazabon.\n");
+    printf("Licensed under the GNU General Public License version 2 (only).\n");
+    printf("\n");
+    check_posix_system();
+    printf("pagesize is %ld\n", (long) alloc.pagesize);
+    printf("pagesizemask is 0x%tx\n", alloc.pagesizemask);
+    if (testmask) {
+        printf("using testmask 0x%lx\n", testmask);
+    }
+    if (procs_spec) {
+        records = run_processes(procs_spec, &alloc, report_format,
+                                report_path);
+        wantbytes_orig = alloc.wantbytes;
+        wantmb = wantbytes_orig >> 20;
+    }
+    if ((records >= 0 ? out_report_fd(records)
+                      : out_report_open(report_format, report_path)) < 0) {
+        return usage(argv[0]);
+    }
+    if (tests_spec) {
+        if (testmask) {
+            fprintf(stderr, "--tests given; ignoring MEMTESTER_TEST_MASK\n");
+            testmask = 0;
         }
-        alloc.buf = (void volatile *) mmap(0, alloc.wantbytes, PROT_READ | PROT_WRITE,
-                                     MAP_SHARED | MAP_LOCKED, memfd,
-                                     physaddrbase);
-        if (alloc.buf == MAP_FAILED) {
-            fprintf(stderr, "failed to mmap %s for physical memory: %s\n",
-                    device_name, strerror(errno));
+        if ((nplan = tests_parse(tests_spec, plan, PLAN_MAX)) < 0) {
+            return usage(argv[0]);
+        }
+    } else {
+        /* The stuck address test, then those in MEMTESTER_TEST_MASK. */
+        plan[0].test = &stuck_address;
+        plan[0].repeat = 1;
+        for (nplan = 1, i = 0; tests[i].name; i++) {
+            if (!testmask || ((1 << i) & testmask)) {
+                plan[nplan].test = &tests[i];
+                plan[nplan++].repeat = 1;
+            }
+        }
+    }
+    if ((norders = order_parse(order_spec, orders, ORDER_MAX,
+                               sysconf(_SC_PAGE_SIZE))) < 0) {
+        return usage(argv[0]);
+    }
+    if (width && kernels_name) {
+        fprintf(stderr, "give --kernels or --width, not both\n");
+        return usage(argv[0]);
+    }
+    if ((width ? kernels_select_width(width, nontemporal)
+               : kernels_select(kernels_name, nontemporal)) < 0) {
+        return usage(argv[0]);
+    }
+    printf("using %s kernels (%u-bit accesses)%s\n", kern->name, kern->width,
+           nontemporal ? " with non-temporal stores" : "");
+    for (p = 0; p < (ul) nplan; p++) {
+        if ((plan[p].test->flags & TEST_HAMMER) && !kernels_can_hammer()) {
+            fprintf(stderr, "cannot flush caches from user space on this "
+                    "CPU; not running %s\n", plan[p].test->id);
             exit(EXIT_FAIL_NONSTARTER);
         }
+        if (plan[p].test == &address_lines && !kernels_can_evict()) {
+            fprintf(stderr, "cannot flush caches from user space on this "
+                    "CPU; %s checks only the address of every word\n",
+                    address_lines.id);
+        }
+    }
+    if (resume) {
+        switch (checkpoint_load(checkpoint_path, &resume_at)) {
+            case 0:
+                if (seed_specified && rng_seed != resume_at.seed) {
+                    fprintf(stderr, "--seed does not match the checkpoint\n");
+                    exit(EXIT_FAIL_NONSTARTER);
+                }
+                rng_seed = resume_at.seed;
+                seed_specified = 1;
+                resuming = 1;
+                break;
+            case 1:
+                printf("no checkpoint in %s; starting from the beginning\n",
+                       checkpoint_path);
+                break;
+            default:
+                exit(EXIT_FAIL_NONSTARTER);
+        }
+    }
+    if (!seed_specified) {
+        rng_seed = ((ull) time(NULL) << 32) ^ (ull) getpid();
+    }
+    printf("using seed 0x%llx\n", rng_seed);
+    printf("want %lluMB (%llu bytes)\n", (ull) wantmb, (ull) alloc.wantbytes);
+    alloc.buf = NULL;
+
+    if (use_phys) {
+        /* accept no less than wantbytes per range, but for alignment */
+        map_ranges(&alloc, alloc.wantbytes, o_flags);
 
-        if (mlock((void *) alloc.buf, alloc.wantbytes) < 0) {
+        if (mlock((void *) alloc.buf, alloc.bufsize) < 0) {
             fprintf(stderr, "failed to mlock mmap'ed space\n");
             alloc.do_mlock = 0;
         }
 
-        alloc.bufsize = alloc.wantbytes; /* accept no less */
         alloc.aligned = alloc.buf;
         done_mem = 1;
     }
 
-    if (alloc.use_hugepages) {
-        alloc_using_hugepages(&alloc);
-    } else {
-        while (!done_mem) {
-            done_mem = alloc_using_malloc(&alloc, wantbytes_orig);
+    if (use_elastic) {
+        if (alloc_elastic(&alloc) < 0) {
+            exit(EXIT_FAIL_NONSTARTER);
         }
+        done_mem = 1;
+    }
+
+    if (!done_mem) {
+        if (alloc_using_mmap(&alloc, wantbytes_orig) < 0) {
+            fprintf(stderr, "failed to allocate memory\n");
+            exit(EXIT_FAIL_NONSTARTER);
+        }
+        alloc.bufsize = alloc.wantbytes;
     }
 
     if (!alloc.do_mlock) fprintf(stderr, "Continuing with unlocked memory; testing "
@@ -471,48 +1720,132 @@ int main(int argc, char **argv) {
         alloc.aligned = alloc.buf;
     }
 
-    halflen = alloc.bufsize / 2;
-    count = halflen / sizeof(ul);
-    bufa = (ulv *) alloc.aligned;
-    bufb = (ulv *) ((size_t) alloc.aligned + halflen);
+    if (use_numa && use_phys) {
+        fprintf(stderr, "NUMA placement (-N) does not apply to -p; "
+                "ignoring it\n");
+        use_numa = 0;
+    }
+    errors_init(sysconf(_SC_PAGE_SIZE));
+    if (soak && soak_init() < 0) {
+        exit(EXIT_FAIL_NONSTARTER);
+    }
+    if (metrics_path && metrics_open(metrics_path) < 0) {
+        exit(EXIT_FAIL_NONSTARTER);
+    }
+    if (ecc && !(k = edac_init())) {
+        printf("no EDAC memory controllers; not counting corrected "
+               "errors\n");
+        ecc = ECC_OFF;
+    } else if (ecc) {
+        printf("counting corrected errors of %d memory controllers\n", k);
+    }
+    for (i = 0; i < n_phys_ranges; i++) {
+        parts[i] = phys_ranges[i].bytes;
+    }
+    workers_start(nthreads, alloc.aligned, alloc.bufsize, alloc.pagesize,
+                  use_numa, parts, n_phys_ranges);
+    soak_set_limits(bandwidth, duty / 100, workers_count());
+
+    if (checkpoint_path && !chunk) {
+        chunk = CHECKPOINT_CHUNK;
+    } else if (workers_count() > 1 && !chunk) {
+        chunk = WORK_CHUNK;
+    }
+    count_chunks(chunk);
+    progress.seed = rng_seed;
+    progress.bytes = wantbytes_orig;
+    progress.bufsize = alloc.bufsize;
+    /* Where each worker's slice lies, and in which range and node. */
+    for (progress.layout = 0, i = 0; i < workers_count(); i++) {
+        progress.layout = rng_key(progress.layout, workers_get(i)->offset);
+        progress.layout = rng_key(progress.layout, workers_get(i)->bytes);
+        progress.layout = rng_key(progress.layout, workers_get(i)->part);
+        progress.layout = rng_key(progress.layout,
+                                  (ull) workers_get(i)->node);
+    }
+    progress.threads = workers_count();
+    progress.chunk = chunk;
+    progress.testmask = testmask;
+    if (snprintf(progress.tests, sizeof(progress.tests), "%s",
+                 tests_spec ? tests_spec : "") >= (int) sizeof(progress.tests) ||
+        snprintf(progress.orders, sizeof(progress.orders), "%s",
+                 order_spec) >= (int) sizeof(progress.orders)) {
+        if (checkpoint_path) {
+            fprintf(stderr, "--tests or --order too long for a checkpoint\n");
+            exit(EXIT_FAIL_NONSTARTER);
+        }
+    }
+    progress.verify_expected = verify_expected;
+    loop = 1;
+    if (resuming) {
+        if (!checkpoint_same_run(&resume_at, &progress)) {
+            fprintf(stderr, "checkpoint %s is from a different run (memory, "
+                    "allocation, threads, chunk size, tests, orders or "
+                    "verify mode)\n",
+                    checkpoint_path);
+            exit(EXIT_FAIL_NONSTARTER);
+        }
+        loop = resume_at.loop;
+        progress.exit_code = resume_at.exit_code;
+        printf("resuming loop %lu from %s\n", loop, checkpoint_path);
+    }
+    job.chunk = chunk;
+    if (characterize && !soak_stop) {
+        characterize_run();
+    }
 
-    for(loop=1; ((!loops) || loop <= loops); loop++) {
+    for(; ((!loops) || loop <= loops) && !soak_stop; loop++) {
+        soak_status.loop = loop;
         printf("Loop %lu", loop);
         if (loops) {
             printf("/%lu", loops);
         }
         printf(":\n");
-        printf("  %-20s: ", "Stuck Address");
-        fflush(stdout);
-        if (!test_stuck_address(alloc.aligned, alloc.bufsize / sizeof(ul))) {
-             printf("ok\n");
-        } else {
-            exit_code |= EXIT_FAIL_ADDRESSLINES;
-        }
-        for (i=0;;i++) {
-            if (!tests[i].name) break;
-            /* If using a custom testmask, only run this test if the
-               bit corresponding to this test was set by the user.
-             */
-            if (testmask && (!((1 << i) & testmask))) {
-                continue;
-            }
-            printf("  %-20s: ", tests[i].name);
-            fflush(stdout);
-            if (!tests[i].fp(bufa, bufb, count)) {
-                printf("ok\n");
-            } else {
-                exit_code |= EXIT_FAIL_OTHERTEST;
+        job.loop = loop;
+        for (p = 0; p < (ul) nplan && !soak_stop; p++) {
+            job.test = plan[p].test;
+            job.index = p;
+            for (r = 0; r < plan[p].repeat && !soak_stop; r++) {
+                job.repeat = r;
+                /* The stuck address test has an order of its own. */
+                for (k = 0; k < ((job.test->flags & TEST_ADDRESS) ? 1 :
+                                 norders) && !soak_stop; k++) {
+                    job.order = k;
+                    if (use_elastic) {
+                        elastic_adjust(&alloc, nthreads, use_numa, chunk,
+                                       bandwidth, duty);
+                    }
+                    if ((from = resume_from(&job)) >= nchunks) {
+                        continue;
+                    }
+                    order = &orders[k];
+                    n = snprintf(label, sizeof(label), "%s", job.test->name);
+                    if (plan[p].repeat > 1) {
+                        n += snprintf(label + n, sizeof(label) - n, " #%lu",
+                                      r + 1);
+                    }
+                    if (norders > 1 && !(job.test->flags & TEST_ADDRESS)) {
+                        snprintf(label + n, sizeof(label) - n, " (%s)",
+                                 order->name);
+                    }
+                    if (run_step(&job, label, from)) {
+                        break;
+                    }
+                }
             }
-            fflush(stdout);
-            /* clear buffer */
-            memset((void *) alloc.buf, 255, alloc.wantbytes);
         }
         printf("\n");
         fflush(stdout);
     }
+    if (checkpoint_path && !soak_stop) {
+        /* Finished; nothing left to resume. */
+        unlink(checkpoint_path);
+    }
+    workers_stop();
+    out_report_close();
+    metrics_close();
     if (alloc.do_mlock) munlock((void *) alloc.aligned, alloc.bufsize);
     printf("Done.\n");
     fflush(stdout);
-    exit(exit_code);
+    exit(progress.exit_code);
 }
@@ -15,7 +15,28 @@
 
 #include <sys/types.h>
 
+/* Exit codes, ORed together. */
+#define EXIT_FAIL_NONSTARTER    0x01
+#define EXIT_FAIL_ADDRESSLINES  0x02
+#define EXIT_FAIL_OTHERTEST     0x04
+#define EXIT_FAIL_CORRECTED     0x08
+
 /* extern declarations. */
 
+#define PHYS_RANGES_MAX 16
+
+/* A range of physical memory or of a device given with -p and -d, and
+   where it was mapped in the buffer under test. */
+struct phys_range {
+    off_t base;                 /* physical address, or offset in device */
+    char *device;
+    size_t dax_align;           /* mapping alignment of DAX memory, or 0 */
+    size_t offset;              /* byte offset in the buffer */
+    size_t bytes;
+};
+
 extern int use_phys;
 extern off_t physaddrbase;
+extern struct phys_range phys_ranges[];
+extern unsigned int n_phys_ranges;
+extern int verify_expected;
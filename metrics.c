@@ -0,0 +1,248 @@
+/*
+ * Very simple but very effective user-space memory tester.
+ * Originally by Simon Kirby <sim@stormix.com> <sim@neato.org>
+ * Version 2 by Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Version 3 not publicly released.
+ * Version 4 rewrite:
+ * Copyright (C) 2004-2020 Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains the metrics file (--metrics), for watching long runs
+ * on many machines.  It is written in the Prometheus text format, to be
+ * picked up by the textfile collector of node_exporter (or anything else
+ * which reads it), after every test and every METRICS_INTERVAL seconds
+ * while one runs, so that a failure shows within seconds of being found
+ * rather than when the run is over.  It is written next to the file and
+ * renamed over it, so readers never see half of it.
+ *
+ * The figures are the ones the rest of memtester keeps anyway: the run
+ * totals of soak_status, the failures per bit and page of errors.c and
+ * the result records of every test, of which the last of each test and
+ * order is kept here.
+ *
+ */
+
+#include <sys/types.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "metrics.h"
+#include "errors.h"
+#include "soak.h"
+
+/* The last result of one test in one order, and the counts of them all. */
+struct test_metrics {
+    const char *test;
+    const char *order;
+    unsigned long long runs;
+    unsigned long long failures;
+    unsigned long long errors;
+    unsigned long long corrected;   /* by ECC, with --ecc */
+    int failed;                     /* the last run */
+    double seconds;
+    double bytes_per_second;
+};
+
+static const char *metrics_path;
+static char *metrics_tmp;
+static struct test_metrics results[METRICS_TESTS];
+static unsigned int n_results;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static pthread_t writer;
+static int writing;
+static int writer_stop;
+
+static void write_metric(FILE *f, const char *name, const char *type,
+                         const char *help) {
+    fprintf(f, "# HELP memtester_%s %s\n# TYPE memtester_%s %s\n", name, help,
+            name, type);
+}
+
+/* Write the file afresh; called with the lock held. */
+static void metrics_write(void) {
+    static struct error_totals totals;
+    struct test_metrics *m;
+    const char *test = soak_status.test;
+    unsigned int i;
+    FILE *f;
+
+    if (!(f = fopen(metrics_tmp, "w"))) {
+        return;
+    }
+    errors_totals(&totals);
+    write_metric(f, "last_update_seconds", "gauge",
+                 "When the file was written, in seconds since the epoch.");
+    fprintf(f, "memtester_last_update_seconds %lld\n",
+            (long long) time(NULL));
+    write_metric(f, "loop", "gauge", "The loop being run.");
+    fprintf(f, "memtester_loop %lu\n", soak_status.loop);
+    write_metric(f, "running", "gauge", "The test being run.");
+    if (test) {
+        fprintf(f, "memtester_running{test=\"%s\"} 1\n", test);
+    }
+    write_metric(f, "tests_run_total", "counter", "Tests run.");
+    fprintf(f, "memtester_tests_run_total %llu\n", soak_status.tests_run);
+    write_metric(f, "tests_failed_total", "counter", "Tests which failed.");
+    fprintf(f, "memtester_tests_failed_total %llu\n",
+            soak_status.tests_failed);
+    write_metric(f, "bytes_total", "counter", "Bytes read and written.");
+    fprintf(f, "memtester_bytes_total %llu\n", soak_status.bytes);
+    write_metric(f, "errors_total", "counter",
+                 "Failures found, including in the test being run.");
+    fprintf(f, "memtester_errors_total %llu\n", totals.total);
+    write_metric(f, "bit_errors_total", "counter",
+                 "Failures found, by bit of the word.");
+    for (i = 0; i < ERROR_BITS; i++) {
+        fprintf(f, "memtester_bit_errors_total{bit=\"%u\"} %llu\n", i,
+                totals.bits[i]);
+    }
+    write_metric(f, "page_errors_total", "counter",
+                 "Failures found in the worst pages, by byte offset, as of "
+                 "the last test.");
+    for (i = 0; i < totals.n_pages; i++) {
+        fprintf(f, "memtester_page_errors_total{offset=\"0x%08lx\"} %llu\n",
+                (unsigned long) totals.page[i], totals.page_count[i]);
+    }
+    write_metric(f, "test_runs_total", "counter", "Runs of each test.");
+    for (i = 0, m = results; i < n_results; i++, m++) {
+        fprintf(f, "memtester_test_runs_total{test=\"%s\",order=\"%s\"} "
+                "%llu\n", m->test, m->order, m->runs);
+    }
+    write_metric(f, "test_failures_total", "counter",
+                 "Runs of each test which failed.");
+    for (i = 0, m = results; i < n_results; i++, m++) {
+        fprintf(f, "memtester_test_failures_total{test=\"%s\",order=\"%s\"} "
+                "%llu\n", m->test, m->order, m->failures);
+    }
+    write_metric(f, "test_errors_total", "counter",
+                 "Failures found by each test.");
+    for (i = 0, m = results; i < n_results; i++, m++) {
+        fprintf(f, "memtester_test_errors_total{test=\"%s\",order=\"%s\"} "
+                "%llu\n", m->test, m->order, m->errors);
+    }
+    write_metric(f, "test_corrected_errors_total", "counter",
+                 "ECC errors corrected while each test ran, with --ecc.");
+    for (i = 0, m = results; i < n_results; i++, m++) {
+        fprintf(f, "memtester_test_corrected_errors_total{test=\"%s\","
+                "order=\"%s\"} %llu\n", m->test, m->order, m->corrected);
+    }
+    write_metric(f, "test_passed", "gauge",
+                 "Whether the last run of each test passed.");
+    for (i = 0, m = results; i < n_results; i++, m++) {
+        fprintf(f, "memtester_test_passed{test=\"%s\",order=\"%s\"} %d\n",
+                m->test, m->order, !m->failed);
+    }
+    write_metric(f, "test_duration_seconds", "gauge",
+                 "How long the last run of each test took.");
+    for (i = 0, m = results; i < n_results; i++, m++) {
+        fprintf(f, "memtester_test_duration_seconds{test=\"%s\",order=\"%s\"} "
+                "%.3f\n", m->test, m->order, m->seconds);
+    }
+    write_metric(f, "test_bandwidth_bytes_per_second", "gauge",
+                 "The bandwidth of the last run of each test.");
+    for (i = 0, m = results; i < n_results; i++, m++) {
+        fprintf(f, "memtester_test_bandwidth_bytes_per_second{test=\"%s\","
+                "order=\"%s\"} %.0f\n", m->test, m->order,
+                m->bytes_per_second);
+    }
+    if (fclose(f) != 0 || rename(metrics_tmp, metrics_path) != 0) {
+        remove(metrics_tmp);
+    }
+}
+
+/* Rewrite the file every METRICS_INTERVAL until metrics_close(). */
+static void *metrics_main(void *arg) {
+    struct timespec until;
+
+    (void) arg;
+    pthread_mutex_lock(&lock);
+    while (!writer_stop) {
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_sec += (time_t) METRICS_INTERVAL;
+        while (!writer_stop &&
+               pthread_cond_timedwait(&wake, &lock, &until) != ETIMEDOUT)
+            ;
+        metrics_write();
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+/* Start writing metrics to path.  Returns -1 if it can't be written. */
+int metrics_open(const char *path) {
+    FILE *f;
+
+    if (!(metrics_tmp = malloc(strlen(path) + 5))) {
+        return -1;
+    }
+    sprintf(metrics_tmp, "%s.tmp", path);
+    if (!(f = fopen(metrics_tmp, "w"))) {
+        perror(metrics_tmp);
+        free(metrics_tmp);
+        return -1;
+    }
+    fclose(f);
+    metrics_path = path;
+    pthread_mutex_lock(&lock);
+    metrics_write();
+    pthread_mutex_unlock(&lock);
+    if (pthread_create(&writer, NULL, metrics_main, NULL) != 0) {
+        fprintf(stderr, "failed to start the metrics writer\n");
+        return -1;
+    }
+    writing = 1;
+    return 0;
+}
+
+/* Count in the result of a test, for all workers, and write the file. */
+void metrics_result(const struct test_result *r) {
+    struct test_metrics *m;
+    unsigned int i;
+
+    if (!writing) {
+        return;
+    }
+    pthread_mutex_lock(&lock);
+    for (i = 0, m = results; i < n_results; i++, m++) {
+        if (!strcmp(m->test, r->test) && !strcmp(m->order, r->order)) {
+            break;
+        }
+    }
+    if (i == n_results && n_results < METRICS_TESTS) {
+        m->test = r->test;
+        m->order = r->order;
+        n_results++;
+    }
+    if (i < n_results) {
+        m->runs++;
+        m->failures += r->failed != 0;
+        m->errors += r->errors;
+        m->corrected += r->corrected;
+        m->failed = r->failed;
+        m->seconds = r->seconds;
+        m->bytes_per_second = r->seconds > 0 ?
+            (r->bytes_read + r->bytes_written) / r->seconds : 0;
+    }
+    metrics_write();
+    pthread_mutex_unlock(&lock);
+}
+
+/* Write the file a last time and stop the writer. */
+void metrics_close(void) {
+    if (!writing) {
+        return;
+    }
+    pthread_mutex_lock(&lock);
+    writer_stop = 1;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+    pthread_join(writer, NULL);
+    writing = 0;
+    free(metrics_tmp);
+}
@@ -0,0 +1,27 @@
+/*
+ * Very simple but very effective user-space memory tester.
+ * Originally by Simon Kirby <sim@stormix.com> <sim@neato.org>
+ * Version 2 by Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Version 3 not publicly released.
+ * Version 4 rewrite:
+ * Copyright (C) 2004-2020 Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains the declarations for the metrics file (--metrics).
+ *
+ */
+
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include "output.h"
+
+#define METRICS_INTERVAL 10.0   /* seconds between rewrites of the file */
+#define METRICS_TESTS 128       /* (test, order) pairs with metrics kept */
+
+int metrics_open(const char *path);
+void metrics_result(const struct test_result *r);
+void metrics_close(void);
+
+#endif /* _METRICS_H_ */
@@ -0,0 +1,134 @@
+/*
+ * Very simple but very effective user-space memory tester.
+ * Originally by Simon Kirby <sim@stormix.com> <sim@neato.org>
+ * Version 2 by Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Version 3 not publicly released.
+ * Version 4 rewrite:
+ * Copyright (C) 2004-2020 Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains the NUMA node helpers used by the worker engine (-N).
+ * Node and CPU lists come from sysfs, and memory is bound to a node with the
+ * raw mbind(2) system call, so no libnuma is needed.  On systems without
+ * either, every helper fails and memtester runs without node placement.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "numa.h"
+
+/* From <linux/mempolicy.h>, which is not always installed. */
+#ifndef MPOL_BIND
+  #define MPOL_BIND 2
+#endif
+#ifndef MPOL_MF_MOVE
+  #define MPOL_MF_MOVE (1 << 1)
+#endif
+
+#define SYSFS_NODE "/sys/devices/system/node"
+#define NODE_CPUS 1024
+
+/* Parse a sysfs list such as "0-3,8,10-11" into ids[]; returns the count. */
+static int read_list(const char *path, int *ids, int max) {
+    FILE *file = fopen(path, "r");
+    int n = 0, lo, hi, c;
+
+    if (file == NULL) {
+        return -1;
+    }
+    while (n < max && fscanf(file, "%d", &lo) == 1) {
+        hi = lo;
+        if ((c = fgetc(file)) == '-') {
+            if (fscanf(file, "%d", &hi) != 1) {
+                break;
+            }
+            c = fgetc(file);
+        }
+        for (; lo <= hi && n < max; lo++) {
+            ids[n++] = lo;
+        }
+        if (c != ',') {
+            break;
+        }
+    }
+    fclose(file);
+    return n;
+}
+
+int node_list(int *nodes, int max) {
+    return read_list(SYSFS_NODE "/online", nodes, max);
+}
+
+int node_cpus(int node, int *cpus, int max) {
+    char path[64];
+
+    snprintf(path, sizeof(path), SYSFS_NODE "/node%d/cpulist", node);
+    return read_list(path, cpus, max);
+}
+
+/* Bind [addr, addr + len) to node, migrating pages already faulted in. */
+int node_bind(void volatile *addr, size_t len, int node) {
+#ifdef SYS_mbind
+    unsigned long mask[NODE_MAX / (8 * sizeof(unsigned long))];
+
+    if (node < 0 || node >= NODE_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    memset(mask, 0, sizeof(mask));
+    mask[node / (8 * sizeof(unsigned long))] |=
+        1UL << (node % (8 * sizeof(unsigned long)));
+    return (int) syscall(SYS_mbind, (void *) addr, len, MPOL_BIND, mask,
+                         (unsigned long) NODE_MAX + 1, MPOL_MF_MOVE);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/* Run the calling process, and the threads it starts from then on, on the
+   CPUs of node, and take all the memory it maps from node. */
+int node_run_on(int node) {
+#if defined(SYS_set_mempolicy) && defined(CPU_SETSIZE)
+    unsigned long mask[NODE_MAX / (8 * sizeof(unsigned long))];
+    int cpus[NODE_CPUS], n, i;
+    cpu_set_t set;
+
+    if (node < 0 || node >= NODE_MAX ||
+        (n = node_cpus(node, cpus, NODE_CPUS)) < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    CPU_ZERO(&set);
+    for (i = 0; i < n; i++) {
+        if (cpus[i] < CPU_SETSIZE) {
+            CPU_SET(cpus[i], &set);
+        }
+    }
+    /* A node may have memory but no CPUs; run anywhere then. */
+    if (n && sched_setaffinity(0, sizeof(set), &set) < 0) {
+        return -1;
+    }
+    memset(mask, 0, sizeof(mask));
+    mask[node / (8 * sizeof(unsigned long))] |=
+        1UL << (node % (8 * sizeof(unsigned long)));
+    return (int) syscall(SYS_set_mempolicy, MPOL_BIND, mask,
+                         (unsigned long) NODE_MAX + 1);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
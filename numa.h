@@ -0,0 +1,27 @@
+/*
+ * Very simple but very effective user-space memory tester.
+ * Originally by Simon Kirby <sim@stormix.com> <sim@neato.org>
+ * Version 2 by Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Version 3 not publicly released.
+ * Version 4 rewrite:
+ * Copyright (C) 2004-2020 Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains the declarations for the NUMA node helpers.
+ *
+ */
+
+#ifndef _NUMA_H_
+#define _NUMA_H_
+
+#include <stddef.h>
+
+#define NODE_MAX 64
+
+int node_list(int *nodes, int max);
+int node_cpus(int node, int *cpus, int max);
+int node_bind(void volatile *addr, size_t len, int node);
+int node_run_on(int node);
+
+#endif /* _NUMA_H_ */
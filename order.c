@@ -0,0 +1,189 @@
+/*
+ * Very simple but very effective user-space memory tester.
+ * Originally by Simon Kirby <sim@stormix.com> <sim@neato.org>
+ * Version 2 by Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Version 3 not publicly released.
+ * Version 4 rewrite:
+ * Copyright (C) 2004-2020 Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains the access orders the tests can walk memory in
+ * (--order).  A linear walk is easy for the hardware prefetchers and keeps
+ * hitting the same DRAM rows and TLB entries; the other orders cut the
+ * buffer into cache-line or page blocks and visit those backwards, a fixed
+ * stride apart, or in a random permutation, with every block still walked
+ * linearly inside.  The random permutations are a small Feistel network
+ * keyed from the test's random stream, so they need no table and are
+ * repeated exactly by --seed.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+#include "order.h"
+#include "rng.h"
+#include "soak.h"
+
+static const struct order linear = { "linear", ORDER_LINEAR, 0, 0 };
+
+const struct order *order = &linear;
+
+/* Parse one order name into o; returns -1 if it is not one. */
+static int parse_one(const char *name, struct order *o, size_t pagesize) {
+    char *suffix;
+    ul stride;
+
+    memset(o, 0, sizeof(*o));
+    snprintf(o->name, sizeof(o->name), "%s", name);
+    o->block = ORDER_LINE;
+    if (!strcmp(name, "linear")) {
+        o->kind = ORDER_LINEAR;
+        o->block = 0;
+    } else if (!strcmp(name, "reverse")) {
+        o->kind = ORDER_REVERSE;
+    } else if (!strcmp(name, "interleave")) {
+        o->kind = ORDER_STRIDE;
+        o->stride = pagesize;
+    } else if (!strncmp(name, "stride:", 7)) {
+        stride = strtoul(name + 7, &suffix, 0);
+        if (*suffix != '\0' || !stride || stride % ORDER_LINE) {
+            fprintf(stderr, "stride must be a multiple of %d bytes\n",
+                    ORDER_LINE);
+            return -1;
+        }
+        o->kind = ORDER_STRIDE;
+        o->stride = stride;
+    } else if (!strcmp(name, "random-line")) {
+        o->kind = ORDER_RANDOM;
+    } else if (!strcmp(name, "random-page")) {
+        o->kind = ORDER_RANDOM;
+        o->block = pagesize;
+    } else {
+        fprintf(stderr, "unknown order %s\n", name);
+        return -1;
+    }
+    return 0;
+}
+
+/* Parse a comma-separated list of orders; returns how many, or -1. */
+int order_parse(const char *spec, struct order *orders, int max,
+                size_t pagesize) {
+    char name[32];
+    const char *end;
+    size_t len;
+    int n = 0;
+
+    for (;;) {
+        end = strchr(spec, ',');
+        len = end ? (size_t) (end - spec) : strlen(spec);
+        if (n == max || len >= sizeof(name)) {
+            fprintf(stderr, "too many or too long orders\n");
+            return -1;
+        }
+        memcpy(name, spec, len);
+        name[len] = '\0';
+        if (parse_one(name, &orders[n++], pagesize) < 0) {
+            return -1;
+        }
+        if (!end) {
+            return n;
+        }
+        spec = end + 1;
+    }
+}
+
+/* One round of mixing for the Feistel network. */
+static ull mix(ull x, ull key) {
+    x = (x ^ key) * 0xbf58476d1ce4e5b9ULL;
+    return x ^ (x >> 31);
+}
+
+/* Map block number n to where it goes in a random permutation of the
+   blocks.  The network permutes [0, 4^half); values past the last block
+   are sent round again until they land on one ("cycle walking"), which
+   keeps it a permutation of [0, nblocks). */
+static size_t permute(const struct order_iter *it, size_t n) {
+    ull mask = (1ULL << it->half) - 1;
+    ull l, r, t;
+    unsigned int i;
+
+    do {
+        l = n >> it->half;
+        r = n & mask;
+        for (i = 0; i < ORDER_ROUNDS; i++) {
+            t = r;
+            r = l ^ (mix(r, it->key[i]) & mask);
+            l = t;
+        }
+        n = (size_t) ((l << it->half) | r);
+    } while (n >= it->nblocks);
+    return n;
+}
+
+void order_start(struct order_iter *it, size_t count) {
+    unsigned int i;
+
+    it->o = order;
+    it->count = count;
+    it->block = order->block ? order->block / sizeof(ul) : count;
+    /* Go in chunks to throttle and to see a stop request in good time. */
+    if ((soak_enabled || soak_throttled) &&
+        it->block > SOAK_CHUNK / sizeof(ul)) {
+        it->block = SOAK_CHUNK / sizeof(ul);
+    }
+    it->nblocks = it->block ? (count + it->block - 1) / it->block : 0;
+    it->n = 0;
+    if (order->kind == ORDER_STRIDE) {
+        it->step = order->stride / order->block;
+        it->phase = 0;
+        it->b = 0;
+    } else if (order->kind == ORDER_RANDOM) {
+        it->half = 1;
+        while ((1ULL << (2 * it->half)) < it->nblocks) {
+            it->half++;
+        }
+        for (i = 0; i < ORDER_ROUNDS; i++) {
+            it->key[i] = rng_next();
+        }
+    }
+}
+
+/* Hand out the next block; returns 0 once every block has been visited. */
+int order_next(struct order_iter *it, size_t *start, size_t *len) {
+    size_t b;
+
+    if (it->n >= it->nblocks || soak_stop) {
+        return 0;
+    }
+    switch (it->o->kind) {
+        case ORDER_REVERSE:
+            b = it->nblocks - 1 - it->n;
+            break;
+        case ORDER_STRIDE:
+            /* Every step-th block, then the same again one block on. */
+            b = it->b;
+            it->b += it->step;
+            if (it->b >= it->nblocks) {
+                it->b = ++it->phase;
+            }
+            break;
+        case ORDER_RANDOM:
+            b = permute(it, it->n);
+            break;
+        default:
+            b = it->n;
+            break;
+    }
+    it->n++;
+    *start = b * it->block;
+    *len = it->count - *start < it->block ? it->count - *start : it->block;
+    if (soak_throttled) {
+        /* Most passes read or write each word of both buffers once. */
+        soak_throttle(2 * *len * sizeof(ul));
+    }
+    return 1;
+}
@@ -0,0 +1,58 @@
+/*
+ * Very simple but very effective user-space memory tester.
+ * Originally by Simon Kirby <sim@stormix.com> <sim@neato.org>
+ * Version 2 by Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Version 3 not publicly released.
+ * Version 4 rewrite:
+ * Copyright (C) 2004-2020 Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains the declarations for the access orders (--order).
+ *
+ */
+
+#ifndef _ORDER_H_
+#define _ORDER_H_
+
+#include <stddef.h>
+
+#define ORDER_MAX 8             /* orders given with --order */
+#define ORDER_LINE 64           /* bytes in a cache-line block */
+#define ORDER_ROUNDS 4          /* Feistel rounds for the random orders */
+
+enum { ORDER_LINEAR, ORDER_REVERSE, ORDER_STRIDE, ORDER_RANDOM };
+
+struct order {
+    char name[32];
+    int kind;
+    size_t block;               /* bytes visited in one go, 0 for all */
+    size_t stride;              /* bytes between blocks, for ORDER_STRIDE */
+};
+
+/* Where a test is in its walk over count words. */
+struct order_iter {
+    const struct order *o;
+    size_t count;
+    size_t block;               /* words per block */
+    size_t nblocks;
+    size_t n;                   /* blocks handed out so far */
+    size_t step, phase, b;      /* ORDER_STRIDE */
+    unsigned int half;          /* ORDER_RANDOM: bits in each Feistel half */
+    unsigned long long key[ORDER_ROUNDS];
+};
+
+/* The order the tests currently run in; set by main() between tests. */
+extern const struct order *order;
+
+int order_parse(const char *spec, struct order *orders, int max,
+                size_t pagesize);
+void order_start(struct order_iter *it, size_t count);
+int order_next(struct order_iter *it, size_t *start, size_t *len);
+
+/* Visit [0, count) block by block in the current order: each time round,
+   words [start, start + len) are next. */
+#define FOR_EACH_BLOCK(it, count, start, len) \
+    for (order_start(&(it), (count)); order_next(&(it), &(start), &(len)); )
+
+#endif /* _ORDER_H_ */
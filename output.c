@@ -5,85 +5,271 @@
  * Output routines to conditionally show testing status.
  *
  * out_initialize() must be called at program startup and disabled status
- * output if stdout is not a tty. The other functions print test progress,
- * but only if on a tty.
+ * output if stdout is not a tty.  While a test runs, out_progress_begin()
+ * starts a reporter thread which shows, on a tty only, how much of it is
+ * done, the bandwidth and the time left.  The workers only bump counters
+ * of their own for it, once a pass or piece of work, so no progress I/O
+ * is left in the test loops and any number of threads can report.
+ *
+ * The out_report_*() functions write one machine-readable record per test
+ * result (JSON lines or CSV) to stdout or to a file, for --format.
  */
 
+#include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "output.h"
+#include "threads.h"
+
+#define PROGRESS_INTERVAL 0.25      /* seconds between progress updates */
 
 static int show_progress = 1;
-static int wheel_pos;
+
+/* The progress reporter, a thread of its own while a test runs. */
+static pthread_t reporter;
+static pthread_mutex_t reporter_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t reporter_wake = PTHREAD_COND_INITIALIZER;
+static int reporter_stop;
+static int reporting;
+static unsigned long long progress_total;
+static double progress_started;
+static int progress_shown;          /* characters of it on the line */
+
+enum { REPORT_NONE, REPORT_JSON, REPORT_CSV };
+static int report_format = REPORT_NONE;
+static FILE *report_file;
+/* The CSV header, which the coordinator also reads the columns from. */
+static const char csv_header[] =
+    "loop,test,order,thread,node,result,errors,bytes_read,bytes_written,"
+    "seconds,gb_per_s,activations,latency_ns,corrected\n";
 
 void out_initialize()
 {
     show_progress = isatty(STDOUT_FILENO);
 }
 
-void out_test_start()
+/* No progress at all, for output that is not read as it comes. */
+void out_progress_disable()
 {
-    if (show_progress) {
-        printf("           ");
-        fflush(stdout);
-    }
+    show_progress = 0;
 }
 
-void out_test_setting(unsigned int j)
+/* Print the progress so far over what was shown before: percent complete,
+   bandwidth and time left. */
+static void show(double now)
 {
-    if (show_progress) {
-        printf("\b\b\b\b\b\b\b\b\b\b\b");
-        printf("setting %3u", j);
-        fflush(stdout);
+    unsigned long long done = 0, bytes = 0;
+    double elapsed = now - progress_started, left;
+    char line[64];
+    struct worker *w;
+    unsigned int i;
+    int n;
+
+    for (i = 0; i < workers_count(); i++) {
+        w = workers_get(i);
+        done += __atomic_load_n(&w->done, __ATOMIC_RELAXED);
+        bytes += __atomic_load_n(&w->bytes_read, __ATOMIC_RELAXED) +
+            __atomic_load_n(&w->bytes_written, __ATOMIC_RELAXED);
+    }
+    if (done > progress_total) {
+        done = progress_total;
+    }
+    n = snprintf(line, sizeof(line), "%3u%% %7.2f GB/s ",
+                 (unsigned int) (done * 100 / progress_total),
+                 elapsed > 0 ? bytes / elapsed / 1e9 : 0);
+    if (done) {
+        left = elapsed * (progress_total - done) / done;
+        snprintf(line + n, sizeof(line) - n, "ETA %lu:%02lu",
+                 (unsigned long) left / 60, (unsigned long) left % 60);
+    } else {
+        snprintf(line + n, sizeof(line) - n, "ETA --:--");
+    }
+    for (i = 0; i < (unsigned int) progress_shown; i++) {
+        putchar('\b');
     }
+    n = printf("%s", line);
+    /* Blank out the rest of a longer line before. */
+    for (i = n; i < (unsigned int) progress_shown; i++) {
+        putchar(' ');
+    }
+    for (i = n; i < (unsigned int) progress_shown; i++) {
+        putchar('\b');
+    }
+    progress_shown = n;
+    fflush(stdout);
 }
 
-void out_test_testing(unsigned int j)
+/* The reporter: wakes up every PROGRESS_INTERVAL to sum the counters the
+   workers keep, without taking anything from them. */
+static void *report_progress(void *arg)
 {
-    if (show_progress) {
-        printf("\b\b\b\b\b\b\b\b\b\b\b");
-        printf("testing %3u", j);
-        fflush(stdout);
+    struct timespec until;
+
+    (void) arg;
+    pthread_mutex_lock(&reporter_lock);
+    while (!reporter_stop) {
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_nsec += (long) (PROGRESS_INTERVAL * 1e9);
+        if (until.tv_nsec >= 1000000000L) {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000L;
+        }
+        while (!reporter_stop &&
+               pthread_cond_timedwait(&reporter_wake, &reporter_lock,
+                                      &until) != ETIMEDOUT)
+            ;
+        if (!reporter_stop) {
+            show(monotonic_seconds());
+        }
     }
+    pthread_mutex_unlock(&reporter_lock);
+    return NULL;
 }
 
-void out_test_end()
+/* Show the progress of the test being run until out_progress_end(): its
+   total is that many pieces of work, see workers_pieces(). */
+void out_progress_begin(unsigned long long total)
 {
-    if (show_progress) {
-        printf("\b\b\b\b\b\b\b\b\b\b\b           \b\b\b\b\b\b\b\b\b\b\b");
-        fflush(stdout);
+    if (!show_progress || !total || reporting) {
+        return;
+    }
+    progress_total = total;
+    progress_started = monotonic_seconds();
+    progress_shown = 0;
+    reporter_stop = 0;
+    if (!pthread_create(&reporter, NULL, report_progress, NULL)) {
+        reporting = 1;
     }
 }
 
-void out_wheel_start()
+/* Stop the reporter and erase what it showed. */
+void out_progress_end()
 {
-    if (show_progress) {
+    int i;
+
+    if (!reporting) {
+        return;
+    }
+    pthread_mutex_lock(&reporter_lock);
+    reporter_stop = 1;
+    pthread_cond_signal(&reporter_wake);
+    pthread_mutex_unlock(&reporter_lock);
+    pthread_join(reporter, NULL);
+    reporting = 0;
+    for (i = 0; i < progress_shown; i++) {
+        putchar('\b');
+    }
+    for (i = 0; i < progress_shown; i++) {
         putchar(' ');
-        fflush(stdout);
-        wheel_pos = 0;
     }
+    for (i = 0; i < progress_shown; i++) {
+        putchar('\b');
+    }
+    fflush(stdout);
 }
 
-void out_wheel_advance(unsigned int i)
+/* For records written to stdout: keep stdout for them alone, and send the
+   text output to stderr from now on.  Returns the stream for the records;
+   call it before anything is printed. */
+FILE *out_records_stdout()
 {
-    static const unsigned int wheel_often = 2500;
-    static const unsigned int n_chars = 4;
-    char wheel_char[4] = {'-', '\\', '|', '/'};
-
-    if (show_progress) {
-        if (!(i % wheel_often)) {
-            putchar('\b');
-            putchar(wheel_char[++wheel_pos % n_chars]);
-            fflush(stdout);
+    static FILE *records;
+    int fd;
+
+    if (!records) {
+        fflush(stdout);
+        if ((fd = dup(STDOUT_FILENO)) < 0 || !(records = fdopen(fd, "w"))) {
+            perror("stdout");
+            return stdout;
         }
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+        show_progress = show_progress && isatty(STDOUT_FILENO);
     }
+    return records;
 }
 
-void out_wheel_end()
+/* Select the record format ("text" writes none) and where records go;
+   path may be NULL or "-" for stdout.  Returns -1 on error. */
+int out_report_open(const char *format, const char *path)
 {
-    if (show_progress) {
-        printf("\b \b");
-        fflush(stdout);
+    if (!format || !strcmp(format, "text")) {
+        report_format = REPORT_NONE;
+        return 0;
+    } else if (!strcmp(format, "json")) {
+        report_format = REPORT_JSON;
+    } else if (!strcmp(format, "csv")) {
+        report_format = REPORT_CSV;
+    } else {
+        fprintf(stderr, "unknown output format %s\n", format);
+        return -1;
+    }
+    if (!path || !strcmp(path, "-")) {
+        report_file = out_records_stdout();
+    } else if (!(report_file = fopen(path, "w"))) {
+        perror(path);
+        return -1;
+    }
+    if (report_format == REPORT_CSV) {
+        fputs(csv_header, report_file);
+    }
+    return 0;
+}
+
+/* Write CSV records to the open descriptor fd, as a process of the
+   coordinator does for it to read (see coordinator.c). */
+int out_report_fd(int fd)
+{
+    FILE *f = fdopen(fd, "w");
+
+    if (!f) {
+        perror("fdopen");
+        return -1;
+    }
+    report_format = REPORT_CSV;
+    report_file = f;
+    fputs(csv_header, report_file);
+    return 0;
+}
+
+void out_report(const struct test_result *r)
+{
+    double gbps = r->seconds > 0 ?
+        (double) (r->bytes_read + r->bytes_written) / r->seconds / 1e9 : 0;
+
+    switch (report_format) {
+        case REPORT_JSON:
+            fprintf(report_file, "{\"loop\": %lu, \"test\": \"%s\", "
+                    "\"order\": \"%s\", \"thread\": %d, \"node\": %d, \"result\": \"%s\", "
+                    "\"errors\": %llu, \"bytes_read\": %llu, \"bytes_written\": %llu, "
+                    "\"seconds\": %.6f, \"gb_per_s\": %.3f, \"activations\": %llu, \"latency_ns\": %.2f, "
+                    "\"corrected\": %llu}\n",
+                    r->loop, r->test, r->order, r->thread, r->node,
+                    r->failed ? "fail" : "ok", r->errors, r->bytes_read,
+                    r->bytes_written, r->seconds, gbps, r->activations,
+                    r->latency_ns, r->corrected);
+            break;
+        case REPORT_CSV:
+            fprintf(report_file, "%lu,%s,%s,%d,%d,%s,%llu,%llu,%llu,%.6f,%.3f,%llu,%.2f,%llu\n",
+                    r->loop, r->test, r->order, r->thread, r->node,
+                    r->failed ? "fail" : "ok", r->errors, r->bytes_read,
+                    r->bytes_written, r->seconds, gbps, r->activations,
+                    r->latency_ns, r->corrected);
+            break;
+        default:
+            return;
+    }
+    fflush(report_file);
+}
+
+void out_report_close()
+{
+    if (report_file && report_file != stdout) {
+        fclose(report_file);
     }
+    report_file = NULL;
+    report_format = REPORT_NONE;
 }
@@ -8,15 +8,35 @@
 #ifndef _OUTPUT_H_
 #define _OUTPUT_H_
 
+#include <stdio.h>
+
 void out_initialize();
+void out_progress_disable();
+
+void out_progress_begin(unsigned long long total);
+void out_progress_end();
 
-void out_test_start();
-void out_test_setting();
-void out_test_testing();
-void out_test_end();
+/* Result records for --format=json|csv. */
+struct test_result {
+    unsigned long loop;
+    const char *test;
+    const char *order;              /* access order, see order.c */
+    int thread;                     /* worker id, or -1 for all workers */
+    int node;                       /* NUMA node, or -1 */
+    int failed;
+    unsigned long long errors;
+    unsigned long long bytes_read;
+    unsigned long long bytes_written;
+    unsigned long long activations; /* row openings by the hammer test */
+    double latency_ns;              /* per load, for --characterize */
+    unsigned long long corrected;   /* ECC errors corrected, for --ecc */
+    double seconds;
+};
 
-void out_wheel_start();
-void out_wheel_advance();
-void out_wheel_end();
+FILE *out_records_stdout();
+int out_report_open(const char *format, const char *path);
+int out_report_fd(int fd);
+void out_report(const struct test_result *r);
+void out_report_close();
 
 #endif // _OUTPUT_H_
@@ -0,0 +1,104 @@
+/*
+ * Very simple but very effective user-space memory tester.
+ * Originally by Simon Kirby <sim@stormix.com> <sim@neato.org>
+ * Version 2 by Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Version 3 not publicly released.
+ * Version 4 rewrite:
+ * Copyright (C) 2004-2020 Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains the physical address resolver used in failure reports
+ * when memtester tests memory it allocated itself.  The page frame of a
+ * failing word is read from /proc/self/pagemap, which is only opened once a
+ * failure is seen, and kept in a small cache since failures tend to come in
+ * runs on the same page.  Reading frame numbers needs CAP_SYS_ADMIN; without
+ * it (or without pagemap) the resolver fails and only offsets are reported.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <sys/types.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "pagemap.h"
+
+#define PM_PRESENT (1ULL << 63)
+#define PM_PFN_MASK ((1ULL << 55) - 1)
+
+struct pagemap_entry {
+    uintptr_t vpage;            /* virtual page number + 1, 0 if unused */
+    unsigned long long pfn;
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int fd = -1;
+static int unavailable;
+static size_t pagesize;
+static struct pagemap_entry cache[PAGEMAP_CACHE];
+
+/* Look up the frame of virtual page vpage; called with the lock held. */
+static int lookup(uintptr_t vpage, unsigned long long *pfn) {
+    struct pagemap_entry *e = &cache[vpage % PAGEMAP_CACHE];
+    uint64_t entry;
+
+    if (e->vpage == vpage + 1) {
+        *pfn = e->pfn;
+        return 0;
+    }
+    if (fd < 0) {
+        if ((fd = open("/proc/self/pagemap", O_RDONLY)) < 0) {
+            return -1;
+        }
+    }
+    if (pread(fd, &entry, sizeof(entry), (off_t) (vpage * sizeof(entry)))
+        != sizeof(entry)) {
+        return -1;
+    }
+    if (!(entry & PM_PRESENT)) {
+        return 1;
+    }
+    /* Unprivileged readers see every frame number as zero. */
+    if (!(entry & PM_PFN_MASK)) {
+        return -1;
+    }
+    e->vpage = vpage + 1;
+    e->pfn = entry & PM_PFN_MASK;
+    *pfn = e->pfn;
+    return 0;
+}
+
+/* Find the physical address of addr; returns 0 on success. */
+int pagemap_phys(void volatile *addr, unsigned long long *phys) {
+#ifdef __linux__
+    uintptr_t va = (uintptr_t) addr;
+    unsigned long long pfn;
+    int r;
+
+    pthread_mutex_lock(&lock);
+    if (unavailable) {
+        pthread_mutex_unlock(&lock);
+        return -1;
+    }
+    if (!pagesize) {
+        pagesize = sysconf(_SC_PAGE_SIZE);
+    }
+    r = lookup(va / pagesize, &pfn);
+    if (r < 0) {
+        /* Don't retry for every failure once we know it can't work. */
+        unavailable = 1;
+    }
+    pthread_mutex_unlock(&lock);
+    if (r) {
+        return -1;
+    }
+    *phys = pfn * pagesize + va % pagesize;
+    return 0;
+#else
+    return -1;
+#endif
+}
@@ -0,0 +1,22 @@
+/*
+ * Very simple but very effective user-space memory tester.
+ * Originally by Simon Kirby <sim@stormix.com> <sim@neato.org>
+ * Version 2 by Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Version 3 not publicly released.
+ * Version 4 rewrite:
+ * Copyright (C) 2004-2020 Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains the declarations for the physical address resolver.
+ *
+ */
+
+#ifndef _PAGEMAP_H_
+#define _PAGEMAP_H_
+
+#define PAGEMAP_CACHE 64        /* pages remembered, direct-mapped */
+
+int pagemap_phys(void volatile *addr, unsigned long long *phys);
+
+#endif /* _PAGEMAP_H_ */
@@ -0,0 +1,78 @@
+/*
+ * Very simple but very effective user-space memory tester.
+ * Originally by Simon Kirby <sim@stormix.com> <sim@neato.org>
+ * Version 2 by Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Version 3 not publicly released.
+ * Version 4 rewrite:
+ * Copyright (C) 2004-2020 Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains the seeding and bulk-fill parts of the pseudo-random
+ * generator.  The generator itself is inline in rng.h.
+ *
+ */
+
+#include <stddef.h>
+
+#include "rng.h"
+
+unsigned long long rng_seed = 0;
+__thread struct rng rng_state = {
+    { 0x9e3779b97f4a7c15ULL, 0xbf58476d1ce4e5b9ULL,
+      0x94d049bb133111ebULL, 0x2545f4914f6cdd1dULL }
+};
+
+static unsigned long long splitmix64(unsigned long long *x) {
+    unsigned long long z = (*x += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* Fold value into the stream number key.  Streams named by several values
+   (a loop, a chunk, ...) are built up with this rather than by shifting
+   each value into bits of its own, which large values would overflow. */
+unsigned long long rng_key(unsigned long long key, unsigned long long value) {
+    unsigned long long x = key;
+
+    /* Hash the key before value goes in, so that the two don't commute
+       (loop 1, chunk 2 against loop 2, chunk 1) or cancel out. */
+    x = splitmix64(&x) ^ value;
+    return splitmix64(&x);
+}
+
+/* Seed the calling thread from rng_seed and the given stream number, so
+   the same seed always gives the same values for the same stream. */
+void rng_init(unsigned long long stream) {
+    unsigned long long x = stream;
+    unsigned long long mix = splitmix64(&x);
+    int i;
+
+    x = rng_seed ^ mix;
+    for (i = 0; i < 4; i++) {
+        rng_state.s[i] = splitmix64(&x);
+    }
+}
+
+void rng_fill(unsigned long volatile *buf, size_t count) {
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        *buf++ = (unsigned long) rng_next();
+    }
+}
+
+/* Write the same random words to both buffers. */
+void rng_fill_pair(unsigned long volatile *bufa, unsigned long volatile *bufb,
+                   size_t count) {
+    unsigned long q;
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        q = (unsigned long) rng_next();
+        *bufa++ = q;
+        *bufb++ = q;
+    }
+}
@@ -0,0 +1,53 @@
+/*
+ * Very simple but very effective user-space memory tester.
+ * Originally by Simon Kirby <sim@stormix.com> <sim@neato.org>
+ * Version 2 by Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Version 3 not publicly released.
+ * Version 4 rewrite:
+ * Copyright (C) 2004-2020 Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains the per-thread pseudo-random generator (xoshiro256**,
+ * seeded through splitmix64) used by the tests instead of rand(3).
+ *
+ */
+
+#ifndef _RNG_H_
+#define _RNG_H_
+
+#include <stddef.h>
+
+struct rng {
+    unsigned long long s[4];
+};
+
+/* Seed of the whole run; every thread's stream is derived from it. */
+extern unsigned long long rng_seed;
+extern __thread struct rng rng_state;
+
+unsigned long long rng_key(unsigned long long key, unsigned long long value);
+void rng_init(unsigned long long stream);
+void rng_fill(unsigned long volatile *buf, size_t count);
+void rng_fill_pair(unsigned long volatile *bufa, unsigned long volatile *bufb,
+                   size_t count);
+
+static inline unsigned long long rng_rotl(unsigned long long x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline unsigned long long rng_next(void) {
+    unsigned long long *s = rng_state.s;
+    unsigned long long r = rng_rotl(s[1] * 5, 7) * 9;
+    unsigned long long t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rng_rotl(s[3], 45);
+    return r;
+}
+
+#endif /* _RNG_H_ */
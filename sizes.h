@@ -14,18 +14,17 @@
 
 #include <limits.h>
 
-#define rand32() ((unsigned int) rand() | ( (unsigned int) rand() << 16))
+#include "rng.h"
+
+#define rand_ul() ((ul) rng_next())
 
 #if (ULONG_MAX == 4294967295UL)
-    #define rand_ul() rand32()
     #define UL_ONEBITS 0xffffffff
     #define UL_LEN 32
     #define CHECKERBOARD1 0x55555555
     #define CHECKERBOARD2 0xaaaaaaaa
     #define UL_BYTE(x) ((x | x << 8 | x << 16 | x << 24))
 #elif (ULONG_MAX == 18446744073709551615ULL)
-    #define rand64() (((ul) rand32()) << 32 | ((ul) rand32()))
-    #define rand_ul() rand64()
     #define UL_ONEBITS 0xffffffffffffffffUL
     #define UL_LEN 64
     #define CHECKERBOARD1 0x5555555555555555
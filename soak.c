@@ -0,0 +1,177 @@
+/*
+ * Very simple but very effective user-space memory tester.
+ * Originally by Simon Kirby <sim@stormix.com> <sim@neato.org>
+ * Version 2 by Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Version 3 not publicly released.
+ * Version 4 rewrite:
+ * Copyright (C) 2004-2020 Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains soak mode (--soak), for running memtester for a long
+ * time on a live host: the threads drop to SCHED_IDLE (or the lowest nice
+ * level), SIGUSR1 prints a status line and SIGTERM or SIGINT stop testing
+ * cleanly.  The signals are taken by a thread of their own with sigwait(),
+ * so the status is printed from normal thread context.
+ *
+ * It also contains the throttle behind --bandwidth and --duty.  The tests
+ * call soak_throttle() for every block they walk (see order.c), which is
+ * kept to SOAK_CHUNK bytes while throttling.  Each worker thread has a
+ * token bucket for its share of the bandwidth, and sleeps off the part of
+ * every DUTY_SLICE worth of work that the duty cycle leaves idle.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "soak.h"
+#include "threads.h"
+
+volatile sig_atomic_t soak_stop = 0;
+int soak_enabled = 0;
+int soak_throttled = 0;
+struct soak_status soak_status;
+
+static double rate;             /* bytes per second, per thread */
+static double duty;             /* fraction of time spent testing */
+static double started;
+
+/* Per-thread throttle state: the token bucket, when it was last topped
+   up, and the work done since the last duty-cycle sleep. */
+static __thread double tokens, refilled, woke, busy;
+
+static void sleep_for(double seconds) {
+    struct timespec ts;
+
+    ts.tv_sec = (time_t) seconds;
+    ts.tv_nsec = (long) ((seconds - (double) ts.tv_sec) * 1e9);
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR) {
+        ;
+    }
+}
+
+/* Charge bytes of testing to the calling thread, sleeping as needed. */
+void soak_throttle(size_t bytes) {
+    double now = monotonic_seconds(), wait = 0;
+
+    if (refilled == 0) {
+        refilled = woke = now;
+        tokens = rate * DUTY_SLICE;
+    }
+    if (rate > 0) {
+        tokens += (now - refilled) * rate;
+        refilled = now;
+        /* Allow bursts of at most one slice's worth. */
+        if (tokens > rate * DUTY_SLICE) {
+            tokens = rate * DUTY_SLICE;
+        }
+        tokens -= (double) bytes;
+        if (tokens < 0) {
+            wait = -tokens / rate;
+        }
+    }
+    if (duty > 0) {
+        busy += now - woke;
+        woke = now;
+        if (busy >= DUTY_SLICE) {
+            if (busy * (1 - duty) / duty > wait) {
+                wait = busy * (1 - duty) / duty;
+            }
+            busy = 0;
+        }
+    }
+    if (wait > 0) {
+        sleep_for(wait);
+        woke = monotonic_seconds();
+    }
+}
+
+/* Leave the CPU to everything else; threads started later inherit it. */
+static void lower_priority(void) {
+#ifdef SCHED_IDLE
+    struct sched_param param;
+
+    memset(&param, 0, sizeof(param));
+    if (sched_setscheduler(0, SCHED_IDLE, &param) == 0) {
+        printf("running at SCHED_IDLE priority\n");
+        return;
+    }
+#endif
+    if (setpriority(PRIO_PROCESS, 0, 19) == 0) {
+        printf("running at nice 19\n");
+    } else {
+        perror("failed to lower priority");
+    }
+}
+
+static void print_status(void) {
+    struct soak_status *s = &soak_status;
+    const char *test = s->test;
+    double up = monotonic_seconds() - started;
+
+    printf("status: up %.0f s, loop %lu, %s%s, %llu tests run, %llu failed, "
+           "%llu errors, %.2f GB tested\n", up, s->loop,
+           test ? "running " : "idle", test ? test : "", s->tests_run,
+           s->tests_failed, s->errors, (double) s->bytes / 1e9);
+    fflush(stdout);
+}
+
+static void *signal_main(void *arg) {
+    sigset_t *set = (sigset_t *) arg;
+    int sig;
+
+    for (;;) {
+        if (sigwait(set, &sig) != 0) {
+            continue;
+        }
+        if (sig == SIGUSR1) {
+            print_status();
+        } else {
+            printf("got signal %d, stopping...\n", sig);
+            fflush(stdout);
+            soak_stop = 1;
+        }
+    }
+    return NULL;
+}
+
+/* Throttle to bandwidth bytes per second for all nthreads together and to
+   a duty cycle of d (a fraction); 0 leaves either off. */
+void soak_set_limits(double bandwidth, double d, unsigned int nthreads) {
+    rate = bandwidth > 0 ? bandwidth / (nthreads ? nthreads : 1) : 0;
+    duty = d > 0 && d < 1 ? d : 0;
+    soak_throttled = rate > 0 || duty > 0;
+}
+
+/* Enter soak mode.  Must be called before any other thread is started, so
+   they all inherit the signal mask and scheduling policy. */
+int soak_init(void) {
+    static sigset_t set;
+    static pthread_t thread;
+    int r;
+
+    started = monotonic_seconds();
+    soak_enabled = 1;
+    lower_priority();
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    sigaddset(&set, SIGTERM);
+    sigaddset(&set, SIGINT);
+    if ((r = pthread_sigmask(SIG_BLOCK, &set, NULL)) != 0 ||
+        (r = pthread_create(&thread, NULL, signal_main, &set)) != 0) {
+        fprintf(stderr, "failed to start signal thread: %s\n", strerror(r));
+        return -1;
+    }
+    pthread_detach(thread);
+    return 0;
+}
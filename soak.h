@@ -0,0 +1,43 @@
+/*
+ * Very simple but very effective user-space memory tester.
+ * Originally by Simon Kirby <sim@stormix.com> <sim@neato.org>
+ * Version 2 by Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Version 3 not publicly released.
+ * Version 4 rewrite:
+ * Copyright (C) 2004-2020 Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains the declarations for soak mode and throttling.
+ *
+ */
+
+#ifndef _SOAK_H_
+#define _SOAK_H_
+
+#include <stddef.h>
+#include <signal.h>
+
+#define SOAK_CHUNK (1UL << 20)  /* bytes tested between throttle checks */
+#define DUTY_SLICE 0.01         /* seconds of work between duty-cycle sleeps */
+
+/* What the SIGUSR1 status line shows; kept up to date by main(). */
+struct soak_status {
+    unsigned long loop;
+    const char *volatile test;
+    unsigned long long tests_run;
+    unsigned long long tests_failed;
+    unsigned long long errors;
+    unsigned long long bytes;
+};
+
+extern volatile sig_atomic_t soak_stop;
+extern int soak_enabled;
+extern int soak_throttled;
+extern struct soak_status soak_status;
+
+int soak_init(void);
+void soak_set_limits(double bandwidth, double duty, unsigned int nthreads);
+void soak_throttle(size_t bytes);
+
+#endif /* _SOAK_H_ */
@@ -14,49 +14,166 @@
  */
 
 #include <sys/types.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <limits.h>
 
 #include "types.h"
 #include "sizes.h"
 #include "memtester.h"
-#include "output.h"
+#include "tests.h"
+#include "threads.h"
+#include "kernels.h"
+#include "errors.h"
+#include "pagemap.h"
+#include "order.h"
+#include "soak.h"
 
 #define ONE 0x00000001L
 
-union {
-    unsigned char bytes[UL_LEN/8];
-    ul val;
-} mword8;
+/* Count the memory traffic of a whole pass, for the throughput report.  The
+   progress reporter reads the counts as they go, hence the atomic stores;
+   only the worker itself ever writes them. */
+#define ACCOUNT(rd, wr) \
+    do { \
+        if (cur_worker) { \
+            __atomic_store_n(&cur_worker->bytes_read, \
+                             cur_worker->bytes_read + (rd), \
+                             __ATOMIC_RELAXED); \
+            __atomic_store_n(&cur_worker->bytes_written, \
+                             cur_worker->bytes_written + (wr), \
+                             __ATOMIC_RELAXED); \
+        } \
+    } while (0)
 
-union {
-    unsigned short u16s[UL_LEN/16];
-    ul val;
-} mword16;
+/* The hammer test.  Rows are taken to be HAMMER_ROW bytes: 8K is the row
+   (page) of a 64-bit DDR3/DDR4 rank of x8 chips, 1K on each of 8 chips;
+   where rows are smaller, as on DDR5, each of ours covers a few of theirs,
+   which are then opened together.  Which rows share a bank
+   is not known from the address; for each victim row, the HAMMER_PROBES
+   rows nearest it on either side are timed against it over
+   HAMMER_PROBE_TOGGLES reads each, and a row counts as being in the
+   victim's bank if it is slower than the median by HAMMER_CONFLICT or
+   more.  The nearest of those above and below the victim are its
+   neighbouring rows in that bank, the aggressors. */
+#define HAMMER_PASSES 2             /* all ones, then all zeroes */
+#define HAMMER_ROW 8192
+#define HAMMER_SPAN (64UL << 20)    /* bytes per HAMMER_VICTIMS victims */
+#define HAMMER_VICTIMS 8
+#define HAMMER_TOGGLES (1UL << 20)  /* reads of each pair, ~2 refreshes */
+#define HAMMER_PROBES 64            /* rows tried each side of a victim */
+#define HAMMER_PROBE_TOGGLES 256
+#define HAMMER_CONFLICT 1.2
 
 /* Function definitions. */
 
+/* Describe where the memory under test lives, for FAILURE lines. */
+static const char *node_label(char *buf, size_t len) {
+    if (cur_worker && cur_worker->slice->node >= 0) {
+        snprintf(buf, len, " on node %d", cur_worker->slice->node);
+    } else {
+        buf[0] = '\0';
+    }
+    return buf;
+}
+
+/* Describe where pa (and pb, if not NULL) are in physical memory, if the
+   kernel will tell us. */
+static char *phys_label(char *buf, size_t len, ulv *pa, ulv *pb) {
+    unsigned long long a, b;
+
+    if (pagemap_phys(pa, &a)) {
+        buf[0] = '\0';
+    } else if (pb && !pagemap_phys(pb, &b)) {
+        snprintf(buf, len, " (physical 0x%08llx / 0x%08llx)", a, b);
+    } else {
+        snprintf(buf, len, " (physical 0x%08llx)", a);
+    }
+    return buf;
+}
+
+/* Physical address (or offset in the device) of the byte at offset in the
+   buffer, with -p: in the range it was mapped from. */
+static off_t phys_address(size_t offset) {
+    unsigned int r;
+
+    if (!n_phys_ranges) {
+        return physaddrbase + offset;
+    }
+    for (r = n_phys_ranges - 1; r > 0 && phys_ranges[r].offset > offset; r--)
+        ;
+    return phys_ranges[r].base + (off_t) (offset - phys_ranges[r].offset);
+}
+
+/* Byte offset of p in the whole buffer under test; tests may be handed
+   any part of any worker's slice. */
+static size_t buffer_offset(ulv *p) {
+    struct worker *s;
+
+    if (!cur_worker) {
+        return 0;
+    }
+    s = cur_worker->slice;
+    return s->offset + ((size_t) p - (size_t) s->base);
+}
+
+/* The passes of a test with 'passes' of them to run in this call: all of
+   them, or those of the current work item. */
+static void pass_range(unsigned int passes, unsigned int *first,
+                       unsigned int *end) {
+    *first = 0;
+    *end = passes;
+    if (cur_worker && cur_worker->pass_end) {
+        *first = cur_worker->pass_first;
+        if (cur_worker->pass_end < passes) {
+            *end = cur_worker->pass_end;
+        }
+    }
+}
+
+/* Report that the word at pa holds a but should match b, which is the word
+   at pb in mirror mode. */
+static void report_failure(ul a, ul b, ulv *pa, ulv *pb) {
+    off_t physaddr;
+    size_t offset = buffer_offset(pa);
+    char where[32], phys[64];
+
+    if (!error_record(offset, a, b)) {
+        return;
+    }
+    if (use_phys) {
+        physaddr = phys_address(offset);
+        fprintf(stderr,
+                "FAILURE: 0x%08lx != 0x%08lx at physical address "
+                "0x%08lx%s.\n",
+                a, b, physaddr, node_label(where, sizeof(where)));
+    } else {
+        fprintf(stderr,
+                "FAILURE: 0x%08lx != 0x%08lx at offset 0x%08lx%s%s.\n",
+                a, b, (ul) offset,
+                phys_label(phys, sizeof(phys), pa, pb),
+                node_label(where, sizeof(where)));
+    }
+}
+
 int compare_regions(ulv *bufa, ulv *bufb, size_t count) {
+    struct order_iter it;
     int r = 0;
-    size_t i;
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    off_t physaddr;
+    size_t i, s, n;
 
-    for (i = 0; i < count; i++, p1++, p2++) {
-        if (*p1 != *p2) {
-            if (use_phys) {
-                physaddr = physaddrbase + (i * sizeof(ul));
-                fprintf(stderr,
-                        "FAILURE: 0x%08lx != 0x%08lx at physical address "
-                        "0x%08lx.\n",
-                        (ul) *p1, (ul) *p2, physaddr);
-            } else {
-                fprintf(stderr,
-                        "FAILURE: 0x%08lx != 0x%08lx at offset 0x%08lx.\n",
-                        (ul) *p1, (ul) *p2, (ul) (i * sizeof(ul)));
+    kern->flush(bufa, count);
+    kern->flush(bufb, count);
+    ACCOUNT(2 * count * sizeof(ul), 0);
+    FOR_EACH_BLOCK(it, count, s, n) {
+        for (i = s; i < s + n; i++) {
+            /* Skip to the next mismatch with the selected compare kernel. */
+            i += kern->compare(bufa + i, bufb + i, s + n - i);
+            if (i >= s + n) {
+                break;
             }
+            report_failure(bufa[i], bufb[i], bufa + i, bufb + i);
             /* printf("Skipping to next test..."); */
             r = -1;
         }
@@ -64,35 +181,148 @@ int compare_regions(ulv *bufa, ulv *bufb, size_t count) {
     return r;
 }
 
+/* Check that buf holds even/odd and, if refill is set, store next_even/
+   next_odd over it in the same pass.  Used instead of a mirror buffer when
+   the expected contents of every word are known (--verify=expected). */
+static int verify_pattern(ulv *buf, size_t count, ul even, ul odd,
+                          int refill, ul next_even, ul next_odd) {
+    struct order_iter it;
+    int r = 0;
+    size_t i, s, n, end;
+    ul e, o, ne, no;
+
+    kern->flush(buf, count);
+    ACCOUNT(count * sizeof(ul), refill ? count * sizeof(ul) : 0);
+    FOR_EACH_BLOCK(it, count, s, n) {
+        for (i = s, end = s + n; i < end; i++) {
+            /* The kernels count even and odd words from where they start. */
+            e = (i % 2) == 0 ? even : odd;
+            o = (i % 2) == 0 ? odd : even;
+            ne = (i % 2) == 0 ? next_even : next_odd;
+            no = (i % 2) == 0 ? next_odd : next_even;
+            if (refill) {
+                i += kern->verify_fill(buf + i, end - i, e, o, ne, no);
+            } else {
+                i += kern->verify(buf + i, end - i, e, o);
+            }
+            if (i >= end) {
+                break;
+            }
+            report_failure(buf[i], (i % 2) == 0 ? even : odd, buf + i, NULL);
+            if (refill) {
+                buf[i] = (i % 2) == 0 ? next_even : next_odd;
+            }
+            r = -1;
+        }
+    }
+    return r;
+}
+
+/* Store even/odd over buf (and bufb, unless it is NULL) in the current
+   order. */
+static void fill_pattern(ulv *bufa, ulv *bufb, size_t count, ul even,
+                         ul odd) {
+    struct order_iter it;
+    size_t s, n;
+    ul e, o;
+
+    FOR_EACH_BLOCK(it, count, s, n) {
+        e = (s % 2) == 0 ? even : odd;
+        o = (s % 2) == 0 ? odd : even;
+        if (bufb) {
+            kern->fill(bufa + s, bufb + s, n, e, o);
+        } else {
+            kern->fill_one(bufa + s, n, e, o);
+        }
+    }
+}
+
+/*
+ * Run a fixed-pattern test.  With a mirror buffer, every pass writes both
+ * buffers and compares them.  Without one (bufb is NULL), the single buffer
+ * is checked against the values each pass should have left, while the next
+ * pass is written over it.
+ */
+static int pattern_test(const struct test *t, ulv *bufa, ulv *bufb,
+                        size_t count) {
+    pattern_fn pattern = t->pattern;
+    unsigned int j, first, passes;
+    ul even, odd, next_even = 0, next_odd = 0;
+
+    pass_range(t->passes, &first, &passes);
+    if (bufb) {
+        for (j = first; j < passes; j++) {
+            pattern(j, &even, &odd);
+            fill_pattern(bufa, bufb, count, even, odd);
+            ACCOUNT(0, 2 * count * sizeof(ul));
+            if (compare_regions(bufa, bufb, count)) {
+                return -1;
+            }
+        }
+    } else {
+        pattern(first, &even, &odd);
+        fill_pattern(bufa, NULL, count, even, odd);
+        ACCOUNT(0, count * sizeof(ul));
+        for (j = first + 1; j <= passes; j++) {
+            if (j < passes) {
+                pattern(j, &next_even, &next_odd);
+            }
+            if (verify_pattern(bufa, count, even, odd, j < passes,
+                               next_even, next_odd)) {
+                return -1;
+            }
+            even = next_even;
+            odd = next_odd;
+        }
+    }
+    return 0;
+}
+
 int test_stuck_address(ulv *bufa, size_t count) {
     ulv *p1 = bufa;
-    unsigned int j;
-    size_t i;
+    unsigned int j, passes;
+    size_t i, c, n;
+    size_t chunk = soak_throttled ? SOAK_CHUNK / sizeof(ul) : count;
+    ul flip;                /* word i holds its address xor flip */
     off_t physaddr;
+    char where[32], phys[64];
 
-    out_test_start();
-    for (j = 0; j < 16; j++) {
+    pass_range(STUCK_ADDRESS_PASSES, &j, &passes);
+    for (; j < passes && !soak_stop; j++) {
         p1 = (ulv *) bufa;
-        out_test_setting(j);
-        for (i = 0; i < count; i++) {
-            *p1 = ((j + i) % 2) == 0 ? (ul) p1 : ~((ul) p1);
-            *p1++;
+        for (c = 0; c < count; c += n) {
+            n = count - c < chunk ? count - c : chunk;
+            if (soak_throttled) {
+                soak_throttle(n * sizeof(ul));
+            }
+            flip = ((j + c) % 2) == 0 ? 0 : UL_ONEBITS;
+            for (i = c; i < c + n; i++, p1++, flip = ~flip) {
+                *p1 = (ul) p1 ^ flip;
+            }
         }
-        out_test_testing(j);
+        ACCOUNT(count * sizeof(ul), count * sizeof(ul));
+        kern->flush(bufa, count);
         p1 = (ulv *) bufa;
-        for (i = 0; i < count; i++, p1++) {
-            if (*p1 != (((j + i) % 2) == 0 ? (ul) p1 : ~((ul) p1))) {
+        flip = (j % 2) == 0 ? 0 : UL_ONEBITS;
+        for (i = 0; i < count; i++, p1++, flip = ~flip) {
+            if (soak_throttled && (i % chunk) == 0) {
+                soak_throttle(chunk * sizeof(ul));
+            }
+            if (*p1 != ((ul) p1 ^ flip)) {
+                error_record(buffer_offset(p1), *p1, (ul) p1 ^ flip);
                 if (use_phys) {
-                    physaddr = physaddrbase + (i * sizeof(ul));
+                    physaddr = phys_address(buffer_offset(p1));
                     fprintf(stderr,
                             "FAILURE: possible bad address line at physical "
-                            "address 0x%08lx.\n",
-                            physaddr);
+                            "address 0x%08lx%s.\n",
+                            physaddr, node_label(where, sizeof(where)));
                 } else {
                     fprintf(stderr,
                             "FAILURE: possible bad address line at offset "
-                            "0x%08lx.\n",
-                            (ul) (i * sizeof(ul)));
+                            "0x%08lx%s%s.\n",
+                            (ul) buffer_offset(p1),
+                            phys_label(phys, sizeof(phys), p1, NULL),
+                            node_label(where, sizeof(where)));
                 }
                 printf("Skipping to next test...\n");
                 fflush(stdout);
@@ -100,368 +330,695 @@ int test_stuck_address(ulv *bufa, size_t count) {
             }
         }
     }
-    out_test_end();
+    return 0;
+}
+
+static int by_latency(const void *a, const void *b) {
+    double da = *(const double *) a, db = *(const double *) b;
+
+    return da < db ? -1 : da > db;
+}
+
+/* Where p is in memory, for telling which rows lie either side of the
+   victim: its physical address if pagemap gives one, else its virtual
+   address, which is only as good as the pages are large. */
+static unsigned long long hammer_where(ulv *p) {
+    unsigned long long pa;
+
+    return pagemap_phys(p, &pa) ? (unsigned long long) (size_t) p : pa;
+}
+
+/*
+ * Find the aggressors of the victim row v among the count words at buf:
+ * of the HAMMER_PROBES rows either side of v, those that take measurably
+ * longer to read in turn with v are in other rows of its bank, and the
+ * nearest of them below and above v are the rows next to it in the bank.
+ * Returns 0 with *below and *above set, 1 if no such row was found on
+ * both sides, or -1 if caches can't be flushed from user space.
+ */
+static int hammer_aggressors(ulv *buf, size_t count, ulv *v, ulv **below,
+                             ulv **above) {
+    size_t rows = count * sizeof(ul) / HAMMER_ROW;
+    size_t row = ((size_t) v - (size_t) buf) / HAMMER_ROW;
+    ulv *cand[2 * HAMMER_PROBES];
+    double lat[2 * HAMMER_PROBES], sorted[2 * HAMMER_PROBES];
+    double start, threshold;
+    unsigned long long at, pv = hammer_where(v);
+    unsigned long long best_below = 0, best_above = ~0ULL;
+    unsigned int i, n = 0;
+    size_t k;
+
+    for (k = 1; k <= HAMMER_PROBES; k++) {
+        if (row >= k) {
+            cand[n++] = (ulv *) ((char *) buf + (row - k) * HAMMER_ROW);
+        }
+        if (row + k < rows) {
+            cand[n++] = (ulv *) ((char *) buf + (row + k) * HAMMER_ROW);
+        }
+    }
+    if (n < 2) {
+        return 1;
+    }
+    for (i = 0; i < n; i++) {
+        start = monotonic_seconds();
+        if (kernels_hammer(v, cand[i], HAMMER_PROBE_TOGGLES) < 0) {
+            return -1;
+        }
+        lat[i] = sorted[i] = monotonic_seconds() - start;
+    }
+    qsort(sorted, n, sizeof(sorted[0]), by_latency);
+    threshold = sorted[n / 2] * HAMMER_CONFLICT;
+    *below = *above = NULL;
+    for (i = 0; i < n; i++) {
+        if (lat[i] < threshold) {
+            continue;
+        }
+        at = hammer_where(cand[i]);
+        if (at < pv && (!*below || at > best_below)) {
+            *below = cand[i];
+            best_below = at;
+        } else if (at > pv && (!*above || at < best_above)) {
+            *above = cand[i];
+            best_above = at;
+        }
+    }
+    return *below && *above ? 0 : 1;
+}
+
+/*
+ * Hammer test: fill the buffer, then for victim rows here and there, read
+ * the rows either side of each in its bank in turn as fast as the caches
+ * can be flushed between reads, so that the victim is disturbed from both
+ * sides far more often than refresh allows for, and check that every word
+ * still holds what was written.  Each pass fills with another solid
+ * pattern, so both kinds of cell hold charge once.  Victims without an
+ * aggressor on both sides are not hammered, and only the reads of those
+ * which are, are counted as activations.
+ */
+int test_row_hammer(ulv *bufa, ulv *bufb, size_t count) {
+    size_t rows = count * sizeof(ul) / HAMMER_ROW;
+    size_t k, victims = HAMMER_VICTIMS *
+        ((count * sizeof(ul) + HAMMER_SPAN - 1) / HAMMER_SPAN);
+    unsigned int j, passes;
+    ulv *v, *below, *above;
+    ul q;
+    int r;
+
+    (void) bufb;
+    pass_range(HAMMER_PASSES, &j, &passes);
+    for (; j < passes && !soak_stop; j++) {
+        q = (j % 2) == 0 ? UL_ONEBITS : 0;
+        fill_pattern(bufa, NULL, count, q, q);
+        ACCOUNT(0, count * sizeof(ul));
+        for (k = 0; rows > 2 && k < victims && !soak_stop; k++) {
+            v = (ulv *) ((char *) bufa + (rand_ul() % rows) * HAMMER_ROW);
+            r = hammer_aggressors(bufa, count, v, &below, &above);
+            if (r == 0) {
+                r = kernels_hammer(below, above, HAMMER_TOGGLES);
+            }
+            if (r < 0) {
+                fprintf(stderr, "cannot flush caches from user space on "
+                        "this CPU; not hammering\n");
+                return -1;
+            }
+            if (r == 0 && cur_worker) {
+                cur_worker->activations += 2 * HAMMER_TOGGLES;
+            }
+        }
+        if (verify_pattern(bufa, count, q, q, 0, 0, 0)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Report a failure of the address line test at p, which held actual instead
+   of expected. */
+static void address_failure(ulv *p, ul actual, ul expected, const char *what) {
+    off_t physaddr;
+    char where[32], phys[64];
+
+    error_record(buffer_offset(p), actual, expected);
+    if (use_phys) {
+        physaddr = phys_address(buffer_offset(p));
+        fprintf(stderr, "FAILURE: %s at physical address 0x%08lx%s.\n", what,
+                physaddr, node_label(where, sizeof(where)));
+    } else {
+        fprintf(stderr, "FAILURE: %s at offset 0x%08lx%s%s.\n", what,
+                (ul) buffer_offset(p), phys_label(phys, sizeof(phys), p, NULL),
+                node_label(where, sizeof(where)));
+    }
+}
+
+/*
+ * Fast address line test, for screening.  First, for each address bit b
+ * inside the buffer, the word at offset 2^b is written with the inverse of
+ * what the words at offset 0 and every other power of two hold, evicted
+ * from the caches, and those words are checked: a bit stuck high makes
+ * word 0 alias word 2^b, one stuck low or shorted to another makes 2^b
+ * alias 0 or that other word.  That takes a few accesses per pair of bits.
+ * Then every word is written with its own address in one streaming pass
+ * and checked in another, which finds any aliasing left, including that of
+ * the page frames behind the buffer.  Two passes over memory instead of
+ * the stuck address test's 32.  Where the CPU can't evict lines from user
+ * space, the first part would only read back the caches, and is skipped.
+ */
+int test_address_lines(ulv *bufa, ulv *bufb, size_t count) {
+    size_t i, c, n, t, b, bits, shift;
+    size_t chunk = soak_throttled ? SOAK_CHUNK / sizeof(ul) : count;
+    ul pattern = CHECKERBOARD1, anti = ~pattern;
+    ulv *p;
+    char what[64];
+
+    (void) bufb;
+    for (bits = 0; ((size_t) 1 << bits) < count; bits++)
+        ;
+    /* Bits are counted in words; failures name them in bytes. */
+    for (shift = 0; ((size_t) 1 << shift) < sizeof(ul); shift++)
+        ;
+    bufa[0] = pattern;
+    for (b = 0; b < bits; b++) {
+        bufa[(size_t) 1 << b] = pattern;
+    }
+    for (t = 0; kernels_can_evict() && t <= bits; t++) {
+        /* t == bits stands for offset 0. */
+        p = t < bits ? bufa + ((size_t) 1 << t) : bufa;
+        *p = anti;
+        kernels_evict(bufa, 1);
+        for (b = 0; b < bits; b++) {
+            kernels_evict(bufa + ((size_t) 1 << b), 1);
+        }
+        if (t < bits && bufa[0] != pattern) {
+            snprintf(what, sizeof(what), "address bit %lu stuck low",
+                     (ul) (t + shift));
+            address_failure(bufa, bufa[0], pattern, what);
+            return -1;
+        }
+        for (b = 0; b < bits; b++) {
+            if (b != t && bufa[(size_t) 1 << b] != pattern) {
+                if (t < bits) {
+                    snprintf(what, sizeof(what), "address bits %lu and %lu "
+                             "shorted", (ul) (t + shift), (ul) (b + shift));
+                } else {
+                    snprintf(what, sizeof(what), "address bit %lu stuck "
+                             "high", (ul) (b + shift));
+                }
+                address_failure(bufa + ((size_t) 1 << b),
+                                bufa[(size_t) 1 << b], pattern, what);
+                return -1;
+            }
+        }
+        *p = pattern;
+    }
+    ACCOUNT(bits * bits * sizeof(ul), bits * sizeof(ul));
+    for (c = 0, p = bufa; c < count; c += n) {
+        n = count - c < chunk ? count - c : chunk;
+        if (soak_throttled) {
+            soak_throttle(n * sizeof(ul));
+        }
+        for (i = 0; i < n; i++, p++) {
+            *p = (ul) p;
+        }
+    }
+    kern->flush(bufa, count);
+    for (i = 0, p = bufa; i < count; i++, p++) {
+        if (soak_throttled && (i % chunk) == 0) {
+            soak_throttle(chunk * sizeof(ul));
+        }
+        if (*p != (ul) p) {
+            address_failure(p, *p, (ul) p, "possible bad address line");
+            printf("Skipping to next test...\n");
+            fflush(stdout);
+            return -1;
+        }
+    }
+    ACCOUNT(count * sizeof(ul), count * sizeof(ul));
     return 0;
 }
 
 int test_random_value(ulv *bufa, ulv *bufb, size_t count) {
     ulv *p1 = bufa;
     ulv *p2 = bufb;
-    size_t i;
+    struct order_iter it;
+    size_t s, len;
 
-    out_wheel_start();
-    for (i = 0; i < count; i++) {
-        *p1++ = *p2++ = rand_ul();
-        out_wheel_advance(i);
+    FOR_EACH_BLOCK(it, count, s, len) {
+        rng_fill_pair(p1 + s, p2 + s, len);
     }
-    out_wheel_end();
+    ACCOUNT(0, 2 * count * sizeof(ul));
     return compare_regions(bufa, bufb, count);
 }
 
 int test_xor_comparison(ulv *bufa, ulv *bufb, size_t count) {
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    size_t i;
+    ulv *p1, *p2;
+    struct order_iter it;
+    size_t i, s, n;
     ul q = rand_ul();
 
-    for (i = 0; i < count; i++) {
-        *p1++ ^= q;
-        *p2++ ^= q;
+    FOR_EACH_BLOCK(it, count, s, n) {
+        p1 = bufa + s;
+        p2 = bufb + s;
+        for (i = 0; i < n; i++) {
+            *p1++ ^= q;
+            *p2++ ^= q;
+        }
     }
+    ACCOUNT(2 * count * sizeof(ul), 2 * count * sizeof(ul));
     return compare_regions(bufa, bufb, count);
 }
 
 int test_sub_comparison(ulv *bufa, ulv *bufb, size_t count) {
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    size_t i;
+    ulv *p1, *p2;
+    struct order_iter it;
+    size_t i, s, n;
     ul q = rand_ul();
 
-    for (i = 0; i < count; i++) {
-        *p1++ -= q;
-        *p2++ -= q;
+    FOR_EACH_BLOCK(it, count, s, n) {
+        p1 = bufa + s;
+        p2 = bufb + s;
+        for (i = 0; i < n; i++) {
+            *p1++ -= q;
+            *p2++ -= q;
+        }
     }
+    ACCOUNT(2 * count * sizeof(ul), 2 * count * sizeof(ul));
     return compare_regions(bufa, bufb, count);
 }
 
 int test_mul_comparison(ulv *bufa, ulv *bufb, size_t count) {
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    size_t i;
+    ulv *p1, *p2;
+    struct order_iter it;
+    size_t i, s, n;
     ul q = rand_ul();
 
-    for (i = 0; i < count; i++) {
-        *p1++ *= q;
-        *p2++ *= q;
+    FOR_EACH_BLOCK(it, count, s, n) {
+        p1 = bufa + s;
+        p2 = bufb + s;
+        for (i = 0; i < n; i++) {
+            *p1++ *= q;
+            *p2++ *= q;
+        }
     }
+    ACCOUNT(2 * count * sizeof(ul), 2 * count * sizeof(ul));
     return compare_regions(bufa, bufb, count);
 }
 
 int test_div_comparison(ulv *bufa, ulv *bufb, size_t count) {
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    size_t i;
+    ulv *p1, *p2;
+    struct order_iter it;
+    size_t i, s, n;
     ul q = rand_ul();
 
-    for (i = 0; i < count; i++) {
-        if (!q) {
-            q++;
+    if (!q) {
+        q++;
+    }
+    FOR_EACH_BLOCK(it, count, s, n) {
+        p1 = bufa + s;
+        p2 = bufb + s;
+        for (i = 0; i < n; i++) {
+            *p1++ /= q;
+            *p2++ /= q;
         }
-        *p1++ /= q;
-        *p2++ /= q;
     }
+    ACCOUNT(2 * count * sizeof(ul), 2 * count * sizeof(ul));
     return compare_regions(bufa, bufb, count);
 }
 
 int test_or_comparison(ulv *bufa, ulv *bufb, size_t count) {
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    size_t i;
+    ulv *p1, *p2;
+    struct order_iter it;
+    size_t i, s, n;
     ul q = rand_ul();
 
-    for (i = 0; i < count; i++) {
-        *p1++ |= q;
-        *p2++ |= q;
+    FOR_EACH_BLOCK(it, count, s, n) {
+        p1 = bufa + s;
+        p2 = bufb + s;
+        for (i = 0; i < n; i++) {
+            *p1++ |= q;
+            *p2++ |= q;
+        }
     }
+    ACCOUNT(2 * count * sizeof(ul), 2 * count * sizeof(ul));
     return compare_regions(bufa, bufb, count);
 }
 
 int test_and_comparison(ulv *bufa, ulv *bufb, size_t count) {
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    size_t i;
+    ulv *p1, *p2;
+    struct order_iter it;
+    size_t i, s, n;
     ul q = rand_ul();
 
-    for (i = 0; i < count; i++) {
-        *p1++ &= q;
-        *p2++ &= q;
+    FOR_EACH_BLOCK(it, count, s, n) {
+        p1 = bufa + s;
+        p2 = bufb + s;
+        for (i = 0; i < n; i++) {
+            *p1++ &= q;
+            *p2++ &= q;
+        }
     }
+    ACCOUNT(2 * count * sizeof(ul), 2 * count * sizeof(ul));
     return compare_regions(bufa, bufb, count);
 }
 
 int test_seqinc_comparison(ulv *bufa, ulv *bufb, size_t count) {
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    size_t i;
+    ulv *p1, *p2;
+    struct order_iter it;
+    size_t i, s, n;
     ul q = rand_ul();
 
-    for (i = 0; i < count; i++) {
-        *p1++ = *p2++ = (i + q);
+    FOR_EACH_BLOCK(it, count, s, n) {
+        p1 = bufa + s;
+        p2 = bufb + s;
+        for (i = s; i < s + n; i++) {
+            *p1++ = *p2++ = (i + q);
+        }
     }
+    ACCOUNT(0, 2 * count * sizeof(ul));
     return compare_regions(bufa, bufb, count);
 }
 
-int test_solidbits_comparison(ulv *bufa, ulv *bufb, size_t count) {
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    unsigned int j;
-    ul q;
-    size_t i;
+static void solidbits_pattern(unsigned int j, ul *even, ul *odd) {
+    ul q = (j % 2) == 0 ? UL_ONEBITS : 0;
 
-    out_test_start();
-    for (j = 0; j < 64; j++) {
-        q = (j % 2) == 0 ? UL_ONEBITS : 0;
-        out_test_setting(j);
-        p1 = (ulv *) bufa;
-        p2 = (ulv *) bufb;
-        for (i = 0; i < count; i++) {
-            *p1++ = *p2++ = (i % 2) == 0 ? q : ~q;
-        }
-        out_test_testing(j);
-        if (compare_regions(bufa, bufb, count)) {
-            return -1;
-        }
-    }
-    out_test_end();
-    return 0;
+    *even = q;
+    *odd = ~q;
 }
 
-int test_checkerboard_comparison(ulv *bufa, ulv *bufb, size_t count) {
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    unsigned int j;
-    ul q;
-    size_t i;
+static void checkerboard_pattern(unsigned int j, ul *even, ul *odd) {
+    ul q = (j % 2) == 0 ? CHECKERBOARD1 : CHECKERBOARD2;
 
-    out_test_start();
-    for (j = 0; j < 64; j++) {
-        q = (j % 2) == 0 ? CHECKERBOARD1 : CHECKERBOARD2;
-        out_test_setting(j);
-        p1 = (ulv *) bufa;
-        p2 = (ulv *) bufb;
-        for (i = 0; i < count; i++) {
-            *p1++ = *p2++ = (i % 2) == 0 ? q : ~q;
-        }
-        out_test_testing(j);
-        if (compare_regions(bufa, bufb, count)) {
-            return -1;
-        }
-    }
-    out_test_end();
-    return 0;
+    *even = q;
+    *odd = ~q;
 }
 
-int test_blockseq_comparison(ulv *bufa, ulv *bufb, size_t count) {
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    unsigned int j;
-    size_t i;
-
-    out_test_start();
-    for (j = 0; j < 256; j++) {
-        p1 = (ulv *) bufa;
-        p2 = (ulv *) bufb;
-        out_test_setting(j);
-        for (i = 0; i < count; i++) {
-            *p1++ = *p2++ = (ul) UL_BYTE(j);
-        }
-        out_test_testing(j);
-        if (compare_regions(bufa, bufb, count)) {
-            return -1;
-        }
-    }
-    out_test_end();
-    return 0;
+static void blockseq_pattern(unsigned int j, ul *even, ul *odd) {
+    *even = *odd = (ul) UL_BYTE(j);
 }
 
-int test_walkbits0_comparison(ulv *bufa, ulv *bufb, size_t count) {
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    unsigned int j;
-    size_t i;
-
-    out_test_start();
-    for (j = 0; j < UL_LEN * 2; j++) {
-        p1 = (ulv *) bufa;
-        p2 = (ulv *) bufb;
-        out_test_setting(j);
-        for (i = 0; i < count; i++) {
-            if (j < UL_LEN) { /* Walk it up. */
-                *p1++ = *p2++ = ONE << j;
-            } else { /* Walk it back down. */
-                *p1++ = *p2++ = ONE << (UL_LEN * 2 - j - 1);
-            }
-        }
-        out_test_testing(j);
-        if (compare_regions(bufa, bufb, count)) {
-            return -1;
-        }
+static void walkbits0_pattern(unsigned int j, ul *even, ul *odd) {
+    if (j < UL_LEN) { /* Walk it up. */
+        *even = *odd = ONE << j;
+    } else { /* Walk it back down. */
+        *even = *odd = ONE << (UL_LEN * 2 - j - 1);
     }
-    out_test_end();
-    return 0;
 }
 
-int test_walkbits1_comparison(ulv *bufa, ulv *bufb, size_t count) {
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    unsigned int j;
-    size_t i;
-
-    out_test_start();
-    for (j = 0; j < UL_LEN * 2; j++) {
-        p1 = (ulv *) bufa;
-        p2 = (ulv *) bufb;
-        out_test_setting(j);
-        for (i = 0; i < count; i++) {
-            if (j < UL_LEN) { /* Walk it up. */
-                *p1++ = *p2++ = UL_ONEBITS ^ (ONE << j);
-            } else { /* Walk it back down. */
-                *p1++ = *p2++ = UL_ONEBITS ^ (ONE << (UL_LEN * 2 - j - 1));
-            }
-        }
-        out_test_testing(j);
-        if (compare_regions(bufa, bufb, count)) {
-            return -1;
-        }
+static void walkbits1_pattern(unsigned int j, ul *even, ul *odd) {
+    if (j < UL_LEN) { /* Walk it up. */
+        *even = *odd = UL_ONEBITS ^ (ONE << j);
+    } else { /* Walk it back down. */
+        *even = *odd = UL_ONEBITS ^ (ONE << (UL_LEN * 2 - j - 1));
     }
-    out_test_end();
-    return 0;
 }
 
-int test_bitspread_comparison(ulv *bufa, ulv *bufb, size_t count) {
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    unsigned int j;
-    size_t i;
-
-    out_test_start();
-    for (j = 0; j < UL_LEN * 2; j++) {
-        p1 = (ulv *) bufa;
-        p2 = (ulv *) bufb;
-        out_test_setting(j);
-        for (i = 0; i < count; i++) {
-            if (j < UL_LEN) { /* Walk it up. */
-                *p1++ = *p2++ = (i % 2 == 0)
-                    ? (ONE << j) | (ONE << (j + 2))
-                    : UL_ONEBITS ^ ((ONE << j)
-                                    | (ONE << (j + 2)));
-            } else { /* Walk it back down. */
-                *p1++ = *p2++ = (i % 2 == 0)
-                    ? (ONE << (UL_LEN * 2 - 1 - j)) | (ONE << (UL_LEN * 2 + 1 - j))
-                    : UL_ONEBITS ^ (ONE << (UL_LEN * 2 - 1 - j)
-                                    | (ONE << (UL_LEN * 2 + 1 - j)));
-            }
-        }
-        out_test_testing(j);
-        if (compare_regions(bufa, bufb, count)) {
-            return -1;
-        }
+static void bitspread_pattern(unsigned int j, ul *even, ul *odd) {
+    if (j < UL_LEN) { /* Walk it up. */
+        *even = (ONE << j) | (ONE << (j + 2));
+        *odd = UL_ONEBITS ^ ((ONE << j)
+                             | (ONE << (j + 2)));
+    } else { /* Walk it back down. */
+        *even = (ONE << (UL_LEN * 2 - 1 - j)) | (ONE << (UL_LEN * 2 + 1 - j));
+        *odd = UL_ONEBITS ^ (ONE << (UL_LEN * 2 - 1 - j)
+                             | (ONE << (UL_LEN * 2 + 1 - j)));
     }
-    out_test_end();
-    return 0;
 }
 
-int test_bitflip_comparison(ulv *bufa, ulv *bufb, size_t count) {
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    unsigned int j, k;
-    ul q;
-    size_t i;
-
-    out_test_start();
-    for (k = 0; k < UL_LEN; k++) {
-        q = ONE << k;
-        for (j = 0; j < 8; j++) {
-            q = ~q;
-            out_test_setting(k * 8 + j);
-            p1 = (ulv *) bufa;
-            p2 = (ulv *) bufb;
-            for (i = 0; i < count; i++) {
-                *p1++ = *p2++ = (i % 2) == 0 ? q : ~q;
-            }
-            out_test_testing(k * 8 + j);
-            fflush(stdout);
-            if (compare_regions(bufa, bufb, count)) {
-                return -1;
-            }
-        }
+/* Passes k * 8 to k * 8 + 7 flip bit k, starting with it cleared. */
+static void bitflip_pattern(unsigned int j, ul *even, ul *odd) {
+    ul q = ONE << (j / 8);
+
+    if ((j % 8) % 2 == 0) {
+        q = ~q;
     }
-    out_test_end();
-    return 0;
+    *even = q;
+    *odd = ~q;
 }
 
 #ifdef TEST_NARROW_WRITES
+/*
+ * Narrow write tests: write random words to one buffer whole and to the
+ * other a byte (or halfword) at a time, and compare them; then again with
+ * the buffers the other way round.  The second attempt sets up everything
+ * it uses afresh, the block iterator and both pointers included, so that
+ * nothing of the first carries over into it.
+ */
 int test_8bit_wide_random(ulv* bufa, ulv* bufb, size_t count) {
-    u8v *p1, *t;
-    ulv *p2;
+    /* On the stack, so concurrent tests don't share a scratch word, and
+       read back through the union itself, which is how C lets the bytes
+       of val be looked at as narrower words. */
+    union {
+        unsigned char bytes[UL_LEN/8];
+        ul val;
+    } mword8;
+    u8v *p1;
+    ulv *p2, *wide, *narrow;
+    struct order_iter it;
     int attempt;
     unsigned int b;
-    size_t i;
+    size_t i, s, n;
 
-    out_wheel_start();
     for (attempt = 0; attempt < 2;  attempt++) {
-        if (attempt & 1) {
-            p1 = (u8v *) bufa;
-            p2 = bufb;
-        } else {
-            p1 = (u8v *) bufb;
-            p2 = bufa;
-        }
-        for (i = 0; i < count; i++) {
-            t = mword8.bytes;
-            *p2++ = mword8.val = rand_ul();
-            for (b=0; b < UL_LEN/8; b++) {
-                *p1++ = *t++;
+        narrow = (attempt & 1) ? bufa : bufb;
+        wide = (attempt & 1) ? bufb : bufa;
+        FOR_EACH_BLOCK(it, count, s, n) {
+            p1 = (u8v *) (narrow + s);
+            p2 = wide + s;
+            for (i = 0; i < n; i++) {
+                *p2++ = mword8.val = rand_ul();
+                for (b = 0; b < UL_LEN/8; b++) {
+                    *p1++ = mword8.bytes[b];
+                }
             }
-            out_wheel_advance(i);
         }
+        ACCOUNT(0, 2 * count * sizeof(ul));
         if (compare_regions(bufa, bufb, count)) {
             return -1;
         }
     }
-    out_wheel_end();
     return 0;
 }
 
 int test_16bit_wide_random(ulv* bufa, ulv* bufb, size_t count) {
-    u16v *p1, *t;
-    ulv *p2;
+    union {
+        unsigned short u16s[UL_LEN/16];
+        ul val;
+    } mword16;
+    u16v *p1;
+    ulv *p2, *wide, *narrow;
+    struct order_iter it;
     int attempt;
     unsigned int b;
-    size_t i;
+    size_t i, s, n;
 
-    out_wheel_start();
     for (attempt = 0; attempt < 2; attempt++) {
-        if (attempt & 1) {
-            p1 = (u16v *) bufa;
-            p2 = bufb;
-        } else {
-            p1 = (u16v *) bufb;
-            p2 = bufa;
-        }
-        for (i = 0; i < count; i++) {
-            t = mword16.u16s;
-            *p2++ = mword16.val = rand_ul();
-            for (b = 0; b < UL_LEN/16; b++) {
-                *p1++ = *t++;
+        narrow = (attempt & 1) ? bufa : bufb;
+        wide = (attempt & 1) ? bufb : bufa;
+        FOR_EACH_BLOCK(it, count, s, n) {
+            p1 = (u16v *) (narrow + s);
+            p2 = wide + s;
+            for (i = 0; i < n; i++) {
+                *p2++ = mword16.val = rand_ul();
+                for (b = 0; b < UL_LEN/16; b++) {
+                    *p1++ = mword16.u16s[b];
+                }
             }
-            out_wheel_advance(i);
         }
+        ACCOUNT(0, 2 * count * sizeof(ul));
         if (compare_regions(bufa, bufb, count)) {
             return -1;
         }
     }
-    out_wheel_end();
     return 0;
 }
 #endif
+
+/* The catalog of tests, in the order they are run.  Pattern tests have no
+   fp; they all run through pattern_test(). */
+struct test tests[] = {
+    { .name = "Random Value", .id = "random", .fp = test_random_value,
+      .flags = TEST_OVERWRITES },
+    { .name = "Compare XOR", .id = "xor", .fp = test_xor_comparison },
+    { .name = "Compare SUB", .id = "sub", .fp = test_sub_comparison },
+    { .name = "Compare MUL", .id = "mul", .fp = test_mul_comparison },
+    { .name = "Compare DIV", .id = "div", .fp = test_div_comparison },
+    { .name = "Compare OR", .id = "or", .fp = test_or_comparison },
+    { .name = "Compare AND", .id = "and", .fp = test_and_comparison },
+    { .name = "Sequential Increment", .id = "seqinc",
+      .fp = test_seqinc_comparison, .flags = TEST_OVERWRITES },
+    { .name = "Solid Bits", .id = "solidbits",
+      .flags = TEST_PATTERN | TEST_OVERWRITES, .passes = 64,
+      .pattern = solidbits_pattern },
+    { .name = "Block Sequential", .id = "blockseq",
+      .flags = TEST_PATTERN | TEST_OVERWRITES, .passes = 256,
+      .pattern = blockseq_pattern },
+    { .name = "Checkerboard", .id = "checkerboard",
+      .flags = TEST_PATTERN | TEST_OVERWRITES, .passes = 64,
+      .pattern = checkerboard_pattern },
+    { .name = "Bit Spread", .id = "bitspread",
+      .flags = TEST_PATTERN | TEST_OVERWRITES, .passes = UL_LEN * 2,
+      .pattern = bitspread_pattern },
+    { .name = "Bit Flip", .id = "bitflip",
+      .flags = TEST_PATTERN | TEST_OVERWRITES, .passes = UL_LEN * 8,
+      .pattern = bitflip_pattern },
+    { .name = "Walking Ones", .id = "walking1",
+      .flags = TEST_PATTERN | TEST_OVERWRITES, .passes = UL_LEN * 2,
+      .pattern = walkbits1_pattern },
+    { .name = "Walking Zeroes", .id = "walking0",
+      .flags = TEST_PATTERN | TEST_OVERWRITES, .passes = UL_LEN * 2,
+      .pattern = walkbits0_pattern },
+#ifdef TEST_NARROW_WRITES
+    { .name = "8-bit Writes", .id = "8bit", .fp = test_8bit_wide_random,
+      .flags = TEST_OVERWRITES },
+    { .name = "16-bit Writes", .id = "16bit", .fp = test_16bit_wide_random,
+      .flags = TEST_OVERWRITES },
+#endif
+    { .name = NULL }
+};
+
+/* The stuck address test is not in tests[], so that MEMTESTER_TEST_MASK
+   keeps its meaning, but is run like the others. */
+struct test stuck_address = { .name = "Stuck Address", .id = "stuck",
+                              .flags = TEST_ADDRESS | TEST_OVERWRITES,
+                              .passes = STUCK_ADDRESS_PASSES };
+
+/* The fast address line test, for --tests=addrlines and the quick set. */
+struct test address_lines = { .name = "Address Lines", .id = "addrlines",
+                              .fp = test_address_lines,
+                              .flags = TEST_ADDRESS | TEST_OVERWRITES };
+
+/* Nor is the hammer test, which is run only when asked for by name. */
+struct test row_hammer = { .name = "Row Hammer", .id = "hammer",
+                           .fp = test_row_hammer,
+                           .flags = TEST_SINGLE | TEST_OVERWRITES |
+                                    TEST_HAMMER,
+                           .passes = HAMMER_PASSES };
+
+/* Named sets of tests for --tests; "full" is all of them. */
+static const struct {
+    const char *name;
+    const char *tests;
+} presets[] = {
+    { "quick", "addrlines,random,solidbits,checkerboard" },
+    { "bandwidth", "random,solidbits" },
+};
+
+/* Append a step running test t repeat times in a row to plan. */
+static int plan_add(struct test_step *plan, int n, int max, struct test *t,
+                    unsigned int repeat) {
+    if (n >= max) {
+        fprintf(stderr, "too many tests in --tests (at most %d)\n", max);
+        return -1;
+    }
+    plan[n].test = t;
+    plan[n].repeat = repeat;
+    return n + 1;
+}
+
+/*
+ * Parse a --tests list into plan: comma-separated test names (see the id
+ * of each test above) or preset names, each optionally followed by :N to
+ * run it N times in a row.  Returns the number of steps, or -1 after
+ * printing what is wrong.
+ */
+int tests_parse(const char *spec, struct test_step *plan, int max) {
+    char item[64], *colon, *end;
+    const char *p = spec;
+    unsigned long repeat;
+    struct test *t;
+    size_t len, i;
+    int n = 0, m, j;
+    struct test_step sub[PLAN_MAX];
+
+    while (*p) {
+        len = strcspn(p, ",");
+        if (!len || len >= sizeof(item)) {
+            fprintf(stderr, "bad test list %s\n", spec);
+            return -1;
+        }
+        memcpy(item, p, len);
+        item[len] = '\0';
+        p += len + (p[len] == ',');
+        repeat = 1;
+        if ((colon = strchr(item, ':'))) {
+            *colon = '\0';
+            errno = 0;
+            repeat = strtoul(colon + 1, &end, 10);
+            if (colon[1] < '0' || colon[1] > '9' || *end || !repeat ||
+                errno || repeat > UINT_MAX) {
+                fprintf(stderr, "bad repeat count for %s (1 to %u)\n", item,
+                        UINT_MAX);
+                return -1;
+            }
+        }
+        if (!strcmp(item, stuck_address.id)) {
+            n = plan_add(plan, n, max, &stuck_address, repeat);
+        } else if (!strcmp(item, address_lines.id)) {
+            n = plan_add(plan, n, max, &address_lines, repeat);
+        } else if (!strcmp(item, row_hammer.id)) {
+            n = plan_add(plan, n, max, &row_hammer, repeat);
+        } else if (!strcmp(item, "full")) {
+            n = plan_add(plan, n, max, &stuck_address, repeat);
+            for (t = tests; t->name && n >= 0; t++) {
+                n = plan_add(plan, n, max, t, repeat);
+            }
+        } else {
+            for (t = tests; t->name && strcmp(item, t->id); t++)
+                ;
+            if (t->name) {
+                n = plan_add(plan, n, max, t, repeat);
+            } else {
+                for (i = 0; i < sizeof(presets) / sizeof(presets[0]); i++) {
+                    if (!strcmp(item, presets[i].name)) {
+                        break;
+                    }
+                }
+                if (i == sizeof(presets) / sizeof(presets[0])) {
+                    fprintf(stderr, "unknown test %s; tests are %s, %s",
+                            item, stuck_address.id, address_lines.id);
+                    for (t = tests; t->name; t++) {
+                        fprintf(stderr, ", %s", t->id);
+                    }
+                    fprintf(stderr, ", %s, and the sets full",
+                            row_hammer.id);
+                    for (i = 0; i < sizeof(presets) / sizeof(presets[0]);
+                         i++) {
+                        fprintf(stderr, ", %s", presets[i].name);
+                    }
+                    fprintf(stderr, "\n");
+                    return -1;
+                }
+                m = tests_parse(presets[i].tests, sub, PLAN_MAX);
+                for (j = 0; j < m && n >= 0; j++) {
+                    if (sub[j].repeat > UINT_MAX / repeat) {
+                        fprintf(stderr, "repeat count for %s too large\n",
+                                item);
+                        return -1;
+                    }
+                    n = plan_add(plan, n, max, sub[j].test,
+                                 sub[j].repeat * (unsigned int) repeat);
+                }
+            }
+        }
+        if (n < 0) {
+            return -1;
+        }
+    }
+    if (!n) {
+        fprintf(stderr, "no tests in --tests\n");
+        return -1;
+    }
+    return n;
+}
+
+/* Run test t on count words of bufa and bufb, or of bufa alone if bufb is
+   NULL (TEST_PATTERN, TEST_ADDRESS and TEST_SINGLE tests only). */
+int test_run(const struct test *t, ulv *bufa, ulv *bufb, size_t count) {
+    if (t->flags & TEST_ADDRESS) {
+        return t->fp ? t->fp(bufa, NULL, count)
+                     : test_stuck_address(bufa, count);
+    }
+    if (t->pattern) {
+        return pattern_test(t, bufa, bufb, count);
+    }
+    return t->fp(bufa, bufb, count);
+}
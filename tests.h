@@ -14,9 +14,31 @@
  *
  */
 
+/* Passes of the stuck address test, which the engine may share out between
+   workers a few at a time like those of the tests in tests[]. */
+#define STUCK_ADDRESS_PASSES 16
+
+#define PLAN_MAX 64         /* steps in a --tests list */
+
+/* One entry of a --tests list. */
+struct test_step {
+    struct test *test;
+    unsigned int repeat;
+};
+
+extern struct test tests[];
+extern struct test stuck_address;
+extern struct test address_lines;
+extern struct test row_hammer;
+
+int tests_parse(const char *spec, struct test_step *plan, int max);
+
 /* Function declaration. */
 
+int compare_regions(unsigned long volatile *bufa, unsigned long volatile *bufb, size_t count);
 int test_stuck_address(unsigned long volatile *bufa, size_t count);
+int test_address_lines(unsigned long volatile *bufa, unsigned long volatile *bufb, size_t count);
+int test_row_hammer(unsigned long volatile *bufa, unsigned long volatile *bufb, size_t count);
 int test_random_value(unsigned long volatile *bufa, unsigned long volatile *bufb, size_t count);
 int test_xor_comparison(unsigned long volatile *bufa, unsigned long volatile *bufb, size_t count);
 int test_sub_comparison(unsigned long volatile *bufa, unsigned long volatile *bufb, size_t count);
@@ -25,13 +47,7 @@ int test_div_comparison(unsigned long volatile *bufa, unsigned long volatile *bu
 int test_or_comparison(unsigned long volatile *bufa, unsigned long volatile *bufb, size_t count);
 int test_and_comparison(unsigned long volatile *bufa, unsigned long volatile *bufb, size_t count);
 int test_seqinc_comparison(unsigned long volatile *bufa, unsigned long volatile *bufb, size_t count);
-int test_solidbits_comparison(unsigned long volatile *bufa, unsigned long volatile *bufb, size_t count);
-int test_checkerboard_comparison(unsigned long volatile *bufa, unsigned long volatile *bufb, size_t count);
-int test_blockseq_comparison(unsigned long volatile *bufa, unsigned long volatile *bufb, size_t count);
-int test_walkbits0_comparison(unsigned long volatile *bufa, unsigned long volatile *bufb, size_t count);
-int test_walkbits1_comparison(unsigned long volatile *bufa, unsigned long volatile *bufb, size_t count);
-int test_bitspread_comparison(unsigned long volatile *bufa, unsigned long volatile *bufb, size_t count);
-int test_bitflip_comparison(unsigned long volatile *bufa, unsigned long volatile *bufb, size_t count);
+int test_run(const struct test *t, unsigned long volatile *bufa, unsigned long volatile *bufb, size_t count);
 #ifdef TEST_NARROW_WRITES
 int test_8bit_wide_random(unsigned long volatile *bufa, unsigned long volatile *bufb, size_t count);
 int test_16bit_wide_random(unsigned long volatile *bufa, unsigned long volatile *bufb, size_t count);
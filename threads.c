@@ -0,0 +1,584 @@
+/*
+ * Very simple but very effective user-space memory tester.
+ * Originally by Simon Kirby <sim@stormix.com> <sim@neato.org>
+ * Version 2 by Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Version 3 not publicly released.
+ * Version 4 rewrite:
+ * Copyright (C) 2004-2020 Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains the worker-thread engine.  The tested region is split
+ * into one contiguous slice per worker; each slice is split again into its
+ * own bufa/bufb halves.  Workers are pinned to CPUs, touch their own slice
+ * first, and then run every job handed to them by workers_run() in lockstep
+ * with the other workers, with a barrier between jobs.  In NUMA mode (-N) the
+ * buffer is first cut into one part per node, each part is bound to its node,
+ * and the workers testing a part are pinned to that node's CPUs.  The caller
+ * may also give the parts itself (one per -p range), which are then tested
+ * by workers of their own.
+ *
+ * Tests themselves are usually run with workers_run_items() instead, which
+ * cuts every slice into chunks and queues them, each with its share of the
+ * test's passes, on the deque of the worker owning the slice.  A worker
+ * works through its own deque from the front, and when it runs dry steals
+ * from the back of the others' (from workers on its own node first), so
+ * that fast cores and idle hosts take over the work of slow or busy ones
+ * instead of waiting for them at the barrier.  Workers never steal from
+ * another part given by the caller, so that each part's throughput is that
+ * of its own memory alone.  A chunk only ever runs on one
+ * worker at a time: between groups of passes it goes back to the front of
+ * the deque of whoever ran it, where it can be stolen.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "numa.h"
+#include "threads.h"
+
+/* Passes [pass, passes) of a test on one chunk of a slice; passes is 0 for
+   a test that is not split by pass. */
+struct work_item {
+    struct worker *slice;
+    unsigned long chunk;
+    unsigned int pass;
+    unsigned int passes;
+};
+
+/* The work items queued on one worker, as a ring. */
+struct deque {
+    pthread_mutex_t lock;
+    struct work_item *items;
+    size_t cap;
+    size_t head;
+    size_t n;
+};
+
+/* A minimal barrier, since pthread_barrier_t is optional in POSIX. */
+struct barrier {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    unsigned int count;
+    unsigned int waiting;
+    unsigned long generation;
+};
+
+__thread struct worker *cur_worker = NULL;
+
+static struct worker *workers;
+static unsigned int n_workers;
+static struct barrier job_start, job_done;
+static worker_job_t job_fn;
+static void *job_arg;
+static int job_exit;
+static int job_items;               /* job runs over the work items */
+static struct deque *deques;
+static pthread_mutex_t pending_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long pending;       /* work items not finished yet */
+
+static void barrier_init(struct barrier *b, unsigned int count) {
+    pthread_mutex_init(&b->lock, NULL);
+    pthread_cond_init(&b->cond, NULL);
+    b->count = count;
+    b->waiting = 0;
+    b->generation = 0;
+}
+
+static void barrier_destroy(struct barrier *b) {
+    pthread_cond_destroy(&b->cond);
+    pthread_mutex_destroy(&b->lock);
+}
+
+static void barrier_wait(struct barrier *b) {
+    unsigned long gen;
+
+    pthread_mutex_lock(&b->lock);
+    gen = b->generation;
+    if (++b->waiting == b->count) {
+        b->waiting = 0;
+        b->generation++;
+        pthread_cond_broadcast(&b->cond);
+    } else {
+        while (gen == b->generation) {
+            pthread_cond_wait(&b->cond, &b->lock);
+        }
+    }
+    pthread_mutex_unlock(&b->lock);
+}
+
+/* Fill cpus[] with the CPUs this process may run on; returns how many. */
+static unsigned int allowed_cpus(int *cpus, unsigned int max) {
+    unsigned int n = 0;
+#ifdef CPU_SETSIZE
+    cpu_set_t set;
+    int cpu;
+
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (cpu = 0; cpu < CPU_SETSIZE && n < max; cpu++) {
+            if (CPU_ISSET(cpu, &set)) {
+                if (cpus) cpus[n] = cpu;
+                n++;
+            }
+        }
+    }
+#else
+    (void) cpus;
+    (void) max;
+#endif
+    return n;
+}
+
+unsigned int workers_available_cpus(void) {
+    unsigned int n = allowed_cpus(NULL, (unsigned int) -1);
+#ifdef _SC_NPROCESSORS_ONLN
+    long online;
+
+    if (!n && (online = sysconf(_SC_NPROCESSORS_ONLN)) > 0) {
+        n = (unsigned int) online;
+    }
+#endif
+    return n ? n : 1;
+}
+
+double monotonic_seconds(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/* Run one job on w, timing it and counting the traffic it reports.  The
+   totals add up over jobs until workers_clear(). */
+static int worker_job(struct worker *w, worker_job_t job, void *arg) {
+    double start;
+    int r;
+
+    start = monotonic_seconds();
+    r = job(w, arg);
+    w->seconds += monotonic_seconds() - start;
+    if (r) {
+        w->result = r;
+    }
+    return r;
+}
+
+static void deque_push_front(struct deque *d, const struct work_item *it) {
+    pthread_mutex_lock(&d->lock);
+    d->head = (d->head + d->cap - 1) % d->cap;
+    d->items[d->head] = *it;
+    d->n++;
+    pthread_mutex_unlock(&d->lock);
+}
+
+static int deque_pop_front(struct deque *d, struct work_item *it) {
+    int r = 0;
+
+    pthread_mutex_lock(&d->lock);
+    if (d->n) {
+        *it = d->items[d->head];
+        d->head = (d->head + 1) % d->cap;
+        d->n--;
+        r = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return r;
+}
+
+static int deque_pop_back(struct deque *d, struct work_item *it) {
+    int r = 0;
+
+    pthread_mutex_lock(&d->lock);
+    if (d->n) {
+        d->n--;
+        *it = d->items[(d->head + d->n) % d->cap];
+        r = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return r;
+}
+
+/* Take the next work item for w: its own, or one stolen from the others,
+   trying those on the same node first.  Returns 0 when all are finished. */
+static int take_item(struct worker *w, struct work_item *it) {
+    struct timespec nap = { 0, 100000 };
+    unsigned int i, v;
+    unsigned long left;
+    int same;
+
+    for (;;) {
+        if (deque_pop_front(&deques[w->id], it)) {
+            return 1;
+        }
+        for (same = 1; same >= 0; same--) {
+            for (i = 1; i < n_workers; i++) {
+                v = (w->id + i) % n_workers;
+                if (workers[v].part != w->part) {
+                    continue;
+                }
+                if ((workers[v].node == w->node) == same &&
+                    deque_pop_back(&deques[v], it)) {
+                    return 1;
+                }
+            }
+        }
+        /* Nothing queued; wait for chunks still being run to come back. */
+        pthread_mutex_lock(&pending_lock);
+        left = pending;
+        pthread_mutex_unlock(&pending_lock);
+        if (!left) {
+            return 0;
+        }
+        nanosleep(&nap, NULL);
+    }
+}
+
+/* Work through the queued items until all of them are done. */
+static void run_items(struct worker *w) {
+    struct work_item it;
+    int r;
+
+    while (take_item(w, &it)) {
+        w->slice = it.slice;
+        w->chunk = it.chunk;
+        w->pass_first = it.pass;
+        w->pass_end = 0;
+        if (it.passes) {
+            w->pass_end = it.passes - it.pass > WORK_PASSES ?
+                it.pass + WORK_PASSES : it.passes;
+        }
+        r = worker_job(w, job_fn, job_arg);
+        __atomic_store_n(&w->done, w->done + 1, __ATOMIC_RELAXED);
+        if (!r && w->pass_end && w->pass_end < it.passes) {
+            it.pass = w->pass_end;
+            deque_push_front(&deques[w->id], &it);
+            continue;
+        }
+        /* Done, or failed, which ends the test on this chunk. */
+        pthread_mutex_lock(&pending_lock);
+        pending--;
+        pthread_mutex_unlock(&pending_lock);
+    }
+    w->slice = w;
+    w->chunk = 0;
+    w->pass_first = w->pass_end = 0;
+}
+
+/* Start counting afresh, for a test that takes several jobs. */
+void workers_clear(void) {
+    unsigned int i;
+
+    for (i = 0; i < n_workers; i++) {
+        workers[i].result = 0;
+        workers[i].seconds = 0;
+        workers[i].bytes_read = 0;
+        workers[i].bytes_written = 0;
+        workers[i].errors = 0;
+        workers[i].activations = 0;
+        workers[i].done = 0;
+    }
+}
+
+static void *worker_main(void *arg) {
+    struct worker *w = (struct worker *) arg;
+
+    cur_worker = w;
+    /* First touch, so the slice ends up local to the CPU testing it. */
+    memset((void *) w->base, 255, w->bytes);
+    barrier_wait(&job_done);
+    for (;;) {
+        barrier_wait(&job_start);
+        if (job_exit) {
+            break;
+        }
+        if (job_items) {
+            run_items(w);
+        } else {
+            worker_job(w, job_fn, job_arg);
+        }
+        barrier_wait(&job_done);
+    }
+    return NULL;
+}
+
+static int worker_spawn(struct worker *w) {
+    pthread_attr_t attr;
+    int r;
+
+    pthread_attr_init(&attr);
+#ifdef CPU_SETSIZE
+    if (w->cpu >= 0) {
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+        CPU_SET(w->cpu, &set);
+        pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+    }
+#endif
+    r = pthread_create(&w->thread, &attr, worker_main, w);
+    pthread_attr_destroy(&attr);
+    return r;
+}
+
+#define CPU_MAX 4096
+
+/* Start nthreads workers on the bufsize bytes at aligned, and return how many
+   there are.  The buffer is cut into parts, one per NUMA node with use_numa,
+   or the nparts given (if not 0), and each part gets the same number of
+   workers. */
+unsigned int workers_start(unsigned int nthreads, void volatile *aligned,
+                           size_t bufsize, size_t pagesize, int use_numa,
+                           const size_t *parts, unsigned int nparts) {
+    unsigned int i, j, g, ngroups = 1, per, ncpus;
+    size_t part, part_off, part_len, slice;
+    int nodes[NODE_MAX];
+    int nnodes = 0;
+    int *cpus;
+    int r;
+
+    if (use_numa) {
+        nnodes = node_list(nodes, NODE_MAX);
+        if (nnodes < 1) {
+            fprintf(stderr, "can not read NUMA node list; ignoring -N\n");
+            nnodes = 0;
+        } else if (bufsize / nnodes < pagesize) {
+            fprintf(stderr, "buffer too small to split across %d NUMA "
+                    "nodes; ignoring -N\n", nnodes);
+            nnodes = 0;
+        } else {
+            ngroups = (unsigned int) nnodes;
+        }
+    } else if (nparts > 1) {
+        ngroups = nparts;
+    }
+    if (nthreads < ngroups) {
+        nthreads = ngroups;
+    }
+    /* Run the same number of workers on every node. */
+    nthreads -= nthreads % ngroups;
+    /* Keep every slice at least a page long and page aligned. */
+    if (nthreads > 1 && bufsize / nthreads < pagesize) {
+        nthreads = bufsize / pagesize ? bufsize / pagesize : 1;
+        nthreads -= nthreads % ngroups;
+        fprintf(stderr, "buffer too small; reducing to %u threads\n",
+                nthreads);
+    }
+    per = nthreads / ngroups;
+    part = ngroups > 1 ? (bufsize / ngroups) & ~(pagesize - 1) : bufsize;
+
+    workers = calloc(nthreads, sizeof(*workers));
+    cpus = calloc(CPU_MAX, sizeof(*cpus));
+    if (!workers || !cpus) {
+        fprintf(stderr, "failed to allocate worker state\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (g = 0; g < ngroups; g++) {
+        int node = nnodes ? nodes[g] : -1;
+
+        if (nnodes || ngroups == 1) {
+            part_off = g * part;
+            part_len = (g == ngroups - 1) ? bufsize - part_off : part;
+        } else {
+            for (part_off = 0, i = 0; i < g; i++) {
+                part_off += parts[i];
+            }
+            part_len = parts[g];
+        }
+        slice = per > 1 ? (part_len / per) & ~(pagesize - 1) : part_len;
+        ncpus = 0;
+        if (node >= 0) {
+            if (node_bind((void volatile *) ((size_t) aligned + part_off),
+                          part_len, node) < 0) {
+                fprintf(stderr, "failed to bind memory to node %d: %s\n",
+                        node, strerror(errno));
+            }
+            r = node_cpus(node, cpus, CPU_MAX);
+            ncpus = r > 0 ? (unsigned int) r : 0;
+        }
+        /* Memory-only nodes are tested from any CPU we may use. */
+        if (!ncpus && nthreads > 1) {
+            ncpus = allowed_cpus(cpus, CPU_MAX);
+        }
+        for (j = 0; j < per; j++) {
+            struct worker *w = &workers[g * per + j];
+            size_t half;
+
+            w->id = g * per + j;
+            w->node = node;
+            w->part = nnodes ? 0 : g;
+            w->cpu = ncpus ? cpus[j % ncpus] : -1;
+            w->offset = part_off + j * slice;
+            w->bytes = (j == per - 1) ? part_len - j * slice : slice;
+            w->base = (unsigned long volatile *) ((size_t) aligned + w->offset);
+            half = w->bytes / 2;
+            w->bufa = w->base;
+            w->bufb = (unsigned long volatile *) ((size_t) w->base + half);
+            w->count = half / sizeof(unsigned long);
+            w->slice = w;
+        }
+        if (node >= 0) {
+            printf("node %d: %lluMB, %u threads\n", node,
+                   (unsigned long long) part_len >> 20, per);
+        }
+    }
+    free(cpus);
+    n_workers = nthreads;
+    deques = calloc(nthreads, sizeof(*deques));
+    if (!deques) {
+        fprintf(stderr, "failed to allocate worker state\n");
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < nthreads; i++) {
+        pthread_mutex_init(&deques[i].lock, NULL);
+    }
+    if (nthreads == 1) {
+        return 1;
+    }
+
+    barrier_init(&job_start, nthreads + 1);
+    barrier_init(&job_done, nthreads + 1);
+    job_exit = 0;
+    for (i = 0; i < nthreads; i++) {
+        if ((r = worker_spawn(&workers[i])) != 0) {
+            fprintf(stderr, "failed to start worker thread %u: %s\n", i,
+                    strerror(r));
+            exit(EXIT_FAILURE);
+        }
+    }
+    /* Wait until every worker has touched its slice. */
+    barrier_wait(&job_done);
+    printf("running %u worker threads, %lluMB per thread\n", nthreads,
+           (unsigned long long) workers[0].bytes >> 20);
+    return nthreads;
+}
+
+/* Run job on every worker at once; returns non-zero if any worker has
+   failed since workers_clear(). */
+int workers_run(worker_job_t job, void *arg) {
+    unsigned int i;
+    int r = 0;
+
+    if (n_workers == 1) {
+        cur_worker = &workers[0];
+        worker_job(&workers[0], job, arg);
+        cur_worker = NULL;
+        return workers[0].result;
+    }
+    job_fn = job;
+    job_arg = arg;
+    barrier_wait(&job_start);
+    barrier_wait(&job_done);
+    for (i = 0; i < n_workers; i++) {
+        if (workers[i].result) {
+            r = -1;
+        }
+    }
+    return r;
+}
+
+/* Run job on chunks [first, last) of every slice, split into groups of
+   WORK_PASSES of its passes (if passes is not 0), sharing the work out
+   between the workers as they become free; the job finds the chunk and
+   passes to run in w->slice, w->chunk, w->pass_first and w->pass_end.
+   Returns non-zero if any worker has failed since workers_clear(). */
+int workers_run_items(worker_job_t job, void *arg, unsigned long first,
+                      unsigned long last, unsigned int passes) {
+    struct work_item it;
+    struct deque *d;
+    unsigned long c;
+    unsigned int i;
+    int r = 0;
+
+    if (last <= first) {
+        return 0;
+    }
+    for (i = 0; i < n_workers; i++) {
+        d = &deques[i];
+        /* Room for the worker's own chunks and one stolen. */
+        if (d->cap < last - first + 1) {
+            free(d->items);
+            d->cap = last - first + 1;
+            if (!(d->items = calloc(d->cap, sizeof(*d->items)))) {
+                fprintf(stderr, "failed to allocate work queue\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        d->head = 0;
+        d->n = 0;
+        it.slice = &workers[i];
+        it.pass = 0;
+        it.passes = passes;
+        for (c = first; c < last; c++) {
+            it.chunk = c;
+            d->items[d->n++] = it;
+        }
+    }
+    pending = n_workers * (last - first);
+    job_fn = job;
+    job_arg = arg;
+    if (n_workers == 1) {
+        cur_worker = &workers[0];
+        run_items(&workers[0]);
+        cur_worker = NULL;
+        return workers[0].result;
+    }
+    job_items = 1;
+    barrier_wait(&job_start);
+    barrier_wait(&job_done);
+    job_items = 0;
+    for (i = 0; i < n_workers; i++) {
+        if (workers[i].result) {
+            r = -1;
+        }
+    }
+    return r;
+}
+
+/* The pieces of work workers_run_items() makes of chunks chunks of every
+   slice, for the progress reporter: one for each WORK_PASSES passes. */
+unsigned long long workers_pieces(unsigned long chunks, unsigned int passes) {
+    return (unsigned long long) n_workers * chunks *
+        (passes ? (passes + WORK_PASSES - 1) / WORK_PASSES : 1);
+}
+
+unsigned int workers_count(void) {
+    return n_workers;
+}
+
+struct worker *workers_get(unsigned int i) {
+    return &workers[i];
+}
+
+void workers_stop(void) {
+    unsigned int i;
+
+    if (n_workers > 1) {
+        job_exit = 1;
+        barrier_wait(&job_start);
+        for (i = 0; i < n_workers; i++) {
+            pthread_join(workers[i].thread, NULL);
+        }
+        barrier_destroy(&job_start);
+        barrier_destroy(&job_done);
+    }
+    for (i = 0; i < n_workers; i++) {
+        pthread_mutex_destroy(&deques[i].lock);
+        free(deques[i].items);
+    }
+    free(deques);
+    deques = NULL;
+    free(workers);
+    workers = NULL;
+    n_workers = 0;
+}
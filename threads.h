@@ -0,0 +1,72 @@
+/*
+ * Very simple but very effective user-space memory tester.
+ * Originally by Simon Kirby <sim@stormix.com> <sim@neato.org>
+ * Version 2 by Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Version 3 not publicly released.
+ * Version 4 rewrite:
+ * Copyright (C) 2004-2020 Charles Cazabon <charlesc-memtester@pyropus.ca>
+ * Licensed under the terms of the GNU General Public License version 2 (only).
+ * See the file COPYING for details.
+ *
+ * This file contains the declarations for the worker-thread engine which
+ * runs the tests on several slices of the buffer at the same time.
+ *
+ */
+
+#ifndef _THREADS_H_
+#define _THREADS_H_
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define WORK_CHUNK (64UL << 20)     /* default chunk with several threads */
+#define WORK_PASSES 16              /* passes of a test per work item */
+
+struct worker {
+    pthread_t thread;
+    unsigned int id;
+    int cpu;                        /* CPU pinned to, or -1 */
+    int node;                       /* NUMA node of the slice, or -1 */
+    unsigned int part;              /* part of the buffer, see workers_start() */
+    unsigned long volatile *base;   /* start of this worker's slice */
+    size_t bytes;                   /* length of the slice */
+    size_t offset;                  /* byte offset of the slice in the buffer */
+    unsigned long volatile *bufa;   /* first half of the slice */
+    unsigned long volatile *bufb;   /* second half of the slice */
+    size_t count;                   /* words in each of bufa and bufb */
+    /* The work item being run, see workers_run_items(). */
+    struct worker *slice;           /* whose slice it tests, often this one */
+    unsigned long chunk;            /* chunk of that slice */
+    unsigned int pass_first;        /* passes [pass_first, pass_end) of the */
+    unsigned int pass_end;          /* test, or pass_end 0 for all of them */
+    int result;
+    /* Totals since workers_clear(), for the throughput report. */
+    double seconds;
+    unsigned long long bytes_read;
+    unsigned long long bytes_written;
+    unsigned long long errors;      /* failures recorded, see errors.c */
+    unsigned long long activations; /* row openings by the hammer test */
+    unsigned long long done;        /* pieces of work finished, read (like */
+                                    /* the traffic) by the progress reporter */
+};
+
+typedef int (*worker_job_t)(struct worker *w, void *arg);
+
+/* The worker running on the calling thread, or NULL outside the engine. */
+extern __thread struct worker *cur_worker;
+
+unsigned int workers_available_cpus(void);
+unsigned int workers_start(unsigned int nthreads, void volatile *aligned,
+                           size_t bufsize, size_t pagesize, int use_numa,
+                           const size_t *parts, unsigned int nparts);
+int workers_run(worker_job_t job, void *arg);
+int workers_run_items(worker_job_t job, void *arg, unsigned long first,
+                      unsigned long last, unsigned int passes);
+unsigned long long workers_pieces(unsigned long chunks, unsigned int passes);
+void workers_clear(void);
+void workers_stop(void);
+unsigned int workers_count(void);
+struct worker *workers_get(unsigned int i);
+double monotonic_seconds(void);
+
+#endif /* _THREADS_H_ */
@@ -20,7 +20,24 @@ typedef unsigned long volatile ulv;
 typedef unsigned char volatile u8v;
 typedef unsigned short volatile u16v;
 
+/* struct test flags. */
+#define TEST_PATTERN 0x01   /* fixed patterns, can be checked without bufb */
+#define TEST_OVERWRITES 0x02 /* writes every word before reading any */
+#define TEST_ADDRESS 0x04   /* the stuck address test, on a single buffer */
+#define TEST_SINGLE 0x08    /* runs on a single buffer; fp gets bufb NULL */
+#define TEST_HAMMER 0x10    /* opens rows, needs the caches flushed by hand */
+
+/* Gives the values for the even and odd words on pass j of a pattern test. */
+typedef void (*pattern_fn)(unsigned int j, ul *even, ul *odd);
+
+/* An entry in the catalog of tests, tests[] in tests.c. */
 struct test {
     char *name;
-    int (*fp)();
+    char *id;               /* short name, for --tests */
+    /* Runs the test, for those which are not pattern tests. */
+    int (*fp)(ulv *bufa, ulv *bufb, size_t count);
+    unsigned int flags;
+    unsigned int passes;    /* passes that can be run apart, or 0 */
+    /* For a pattern test, the values stored on each of its passes. */
+    pattern_fn pattern;
 };